@@ -0,0 +1,25 @@
+/*
+ * Kernel mode NEON support
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_NEON_H
+#define __ASM_NEON_H
+
+#include <linux/types.h>
+
+#define cpu_has_neon()		(1)
+
+/*
+ * Kernel mode NEON must be bracketed by kernel_neon_begin() and
+ * kernel_neon_end().  Preemption is disabled in between, and the
+ * userland FP/SIMD state of current, if live, is saved first; it is
+ * reloaded lazily on return to userland.  Not usable from interrupt
+ * context.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif
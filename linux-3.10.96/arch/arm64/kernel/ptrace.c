@@ -523,13 +523,20 @@ static int gpr_set(struct task_struct *target, const struct user_regset *regset,
 }
 
 /*
- * TODO: update fp accessors for lazy context switching (sync/flush hwstate)
+ * The FP accessors must keep the lazily switched register state coherent:
+ * if target is current, its live registers may be newer than the copy in
+ * memory, and after writing the copy in memory any live registers holding
+ * target's old state must no longer be trusted.
  */
 static int fpr_get(struct task_struct *target, const struct user_regset *regset,
 		   unsigned int pos, unsigned int count,
 		   void *kbuf, void __user *ubuf)
 {
 	struct user_fpsimd_state *uregs;
+
+	if (target == current)
+		fpsimd_preserve_current_state();
+
 	uregs = &target->thread.fpsimd_state.user_fpsimd;
 	return user_regset_copyout(&pos, &count, &kbuf, &ubuf, uregs, 0, -1);
 }
@@ -546,6 +553,7 @@ static int fpr_set(struct task_struct *target, const struct user_regset *regset,
 		return ret;
 
 	target->thread.fpsimd_state.user_fpsimd = newstate;
+	fpsimd_flush_task_state(target);
 	return ret;
 }
 
@@ -754,6 +762,9 @@ static int compat_vfp_get(struct task_struct *target,
 	compat_ulong_t fpscr;
 	int ret;
 
+	if (target == current)
+		fpsimd_preserve_current_state();
+
 	uregs = &target->thread.fpsimd_state.user_fpsimd;
 
 	/*
@@ -795,6 +806,7 @@ static int compat_vfp_set(struct task_struct *target,
 		uregs->fpcr = fpscr & VFP_FPSCR_CTRL_MASK;
 	}
 
+	fpsimd_flush_task_state(target);
 	return ret;
 }
 
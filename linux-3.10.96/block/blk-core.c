@@ -41,6 +41,8 @@
 #include "blk-mq.h"
 #include "blk-mq-tag.h"
 #include "blk-mq-sched.h"
+#include "blk-stat.h"
+#include "blk-wbt.h"
 
 #ifdef CONFIG_DEBUG_FS
 struct dentry *blk_debugfs_root;
@@ -624,6 +626,10 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	if (err)
 		goto fail_id;
 
+	q->stats = blk_alloc_queue_stats();
+	if (!q->stats)
+		goto fail_stats;
+
 	setup_timer(&q->backing_dev_info.laptop_mode_wb_timer,
 		    laptop_mode_timer_fn, (unsigned long) q);
 	setup_timer(&q->timeout, blk_rq_timed_out_timer, (unsigned long) q);
@@ -664,6 +670,8 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	return q;
 
 fail_bdi:
+	blk_free_queue_stats(q->stats);
+fail_stats:
 	bdi_destroy(&q->backing_dev_info);
 fail_id:
 	ida_simple_remove(&blk_queue_ida, q->id);
@@ -1232,6 +1240,7 @@ void blk_requeue_request(struct request_queue *q, struct request *rq)
 
 	BUG_ON(blk_queued_rq(rq));
 
+	wbt_requeue(q->rq_wb, &rq->issue_stat);
 	elv_requeue_request(q, rq);
 }
 EXPORT_SYMBOL(blk_requeue_request);
@@ -1319,6 +1328,9 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 
 	elv_completed_request(q, req);
 
+	wbt_done(q->rq_wb, &req->issue_stat);
+	blk_iolatency_done(req);
+
 	/* this is a bio leak */
 	WARN_ON(req->bio != NULL);
 
@@ -1516,6 +1528,8 @@ void blk_queue_bio(struct request_queue *q, struct bio *bio)
 	int el_ret, rw_flags, where = ELEVATOR_INSERT_SORT;
 	struct request *req;
 	unsigned int request_count = 0;
+	unsigned int wb_acct;
+	struct blkcg_gq *iolat_blkg;
 
 	/*
 	 * low level driver can indicate that it wants pages above a
@@ -1591,6 +1605,13 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_SYNC;
 
+	/*
+	 * Writeback throttling may sleep here, dropping and regrabbing
+	 * the queue lock, before we go and allocate a request.
+	 */
+	wb_acct = wbt_wait(q->rq_wb, bio, q->queue_lock);
+	iolat_blkg = blk_iolatency_throttle(q, bio, q->queue_lock);
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
@@ -1598,10 +1619,15 @@ get_rq:
 	//õһµrqп,req->start_timeΪjiffies
 	req = get_request(q, rw_flags, bio, GFP_NOIO);//get_requestػq->queue_lock
 	if (unlikely(!req)) {
+		__wbt_done(q->rq_wb, wb_acct);
+		blk_iolatency_cancel(q, iolat_blkg);
 		bio_endio(bio, -ENODEV);	/* @q is dead */
 		goto out_unlock;
 	}
 
+	wbt_track(&req->issue_stat, wb_acct);
+	blk_iolatency_track(req, iolat_blkg);
+
 	/*
 	 * After dropping the lock and possibly sleeping here, our request
 	 * may now be mergeable after it had proven unmergeable (above).
@@ -2335,6 +2361,12 @@ void blk_start_request(struct request *req)//
     //reqӶ޳
 	blk_dequeue_request(req);
 
+	if (test_bit(QUEUE_FLAG_STATS, &req->q->queue_flags)) {
+		blk_stat_set_issue_time(&req->issue_stat);
+		req->cmd_flags |= REQ_STATS;
+		wbt_issue(req->q->rq_wb, &req->issue_stat);
+	}
+
 	/*
 	 * We are now handing the request to the hardware, initialize
 	 * resid_len to full count and add the timeout handler.
@@ -2567,6 +2599,9 @@ EXPORT_SYMBOL_GPL(blk_unprep_request);
  */
 static void blk_finish_request(struct request *req, int error)
 {
+	if (req->cmd_flags & REQ_STATS)
+		blk_stat_add(req, ktime_to_ns(ktime_get()));
+
 	if (blk_rq_tagged(req))
 		blk_queue_end_tag(req->q, req);
 
@@ -2583,6 +2618,8 @@ static void blk_finish_request(struct request *req, int error)
     //reqˣiostickstime_in_queueio_ticksflightʹü
 	blk_account_io_done(req);
 
+	wbt_done(req->q->rq_wb, &req->issue_stat);
+
 	if (req->end_io)
 		req->end_io(req, error);//صѵȴIOɶߵĽ
 	else {
@@ -0,0 +1,784 @@
+/*
+ * Block io latency controller, cgroup based.
+ *
+ * Each non-root cgroup can be given a latency target per device with
+ * blkio.latency.target_device.  While a group with a target is meeting
+ * it nothing happens.  Once it misses its target, its siblings that have
+ * a higher (or no) target are throttled by shrinking the number of
+ * requests they may have in flight, until the protected group is happy
+ * again.
+ *
+ * Throttling is decided per level of the hierarchy.  Every parent carries
+ * a "scale cookie" for its children: a group that misses its target
+ * lowers its parent's cookie, a group that is meeting it and was the one
+ * that caused the scale down raises it again.  Every child compares the
+ * parent's cookie against its own copy on its next submission and halves
+ * (or grows by 1/16th of the queue depth) its max_depth accordingly.
+ *
+ * Latency is sampled at completion and averaged over a window that is
+ * 16 times the target, clamped to [100msec, 1sec].  Scale events on a
+ * level are spaced at least 500msec apart, so a single bad window can't
+ * collapse the depth of everybody below it.  A timer walks the queue once
+ * a second and brings the cookies back up when the group that caused the
+ * scale down has gone quiet.
+ *
+ * IO issued on behalf of the root (metadata, priority IO and IO from
+ * memory reclaim) is accounted but never made to wait: blocking it behind
+ * a throttled group would just turn into a priority inversion.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/timer.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include "blk-cgroup.h"
+#include "blk.h"
+
+#define DEFAULT_SCALE_COOKIE		1000000U
+
+/* window sizes and scale event spacing, in nsecs */
+#define BLKIOLATENCY_MIN_WIN_SIZE	(100 * NSEC_PER_MSEC)
+#define BLKIOLATENCY_MAX_WIN_SIZE	NSEC_PER_SEC
+#define BLKIOLATENCY_MIN_ADJUST_TIME	(500 * NSEC_PER_MSEC)
+#define BLKIOLATENCY_MIN_GOOD_SAMPLES	5
+
+/* scale down by qd >> 2, up by qd >> 4 */
+#define SCALE_DOWN_FACTOR		2
+#define SCALE_UP_FACTOR			4
+
+static struct blkcg_policy blkcg_policy_iolatency;
+
+struct blk_iolatency {
+	struct request_queue *q;
+	struct timer_list timer;
+	/* number of groups on this queue with a latency target */
+	atomic_t enabled;
+};
+
+struct child_latency_info {
+	spinlock_t lock;
+
+	/* last time we adjusted the scale of our children */
+	u64 last_scale_event;
+
+	/* the target of the group that caused the current scale down */
+	u64 scale_lat;
+
+	/* samples from all of our children in their last windows */
+	u64 nr_samples;
+
+	/* the group that caused the current scale down */
+	struct iolatency_grp *scale_grp;
+
+	/* our children compare against this to scale up or down */
+	atomic_t scale_cookie;
+};
+
+struct iolatency_grp {
+	struct blkg_policy_data pd;
+	struct blk_iolatency *blkiolat;
+	struct rq_wait rq_wait;
+	unsigned int max_depth;
+
+	/* latency target, 0 if none */
+	u64 min_lat_nsec;
+	u64 cur_win_nsec;
+
+	/* samples of the current window */
+	atomic64_t window_start;
+	atomic64_t lat_total;
+	atomic_t nr_lat;
+
+	/* samples of the last completed window */
+	u64 nr_samples;
+
+	/* our copy of the parent's child_lat.scale_cookie */
+	atomic_t scale_cookie;
+
+	struct child_latency_info child_lat;
+};
+
+static inline struct iolatency_grp *pd_to_lat(struct blkg_policy_data *pd)
+{
+	return pd ? container_of(pd, struct iolatency_grp, pd) : NULL;
+}
+
+static inline struct iolatency_grp *blkg_to_lat(struct blkcg_gq *blkg)
+{
+	return pd_to_lat(blkg_to_pd(blkg, &blkcg_policy_iolatency));
+}
+
+static inline struct blkcg_gq *lat_to_blkg(struct iolatency_grp *iolat)
+{
+	return pd_to_blkg(&iolat->pd);
+}
+
+static inline unsigned long scale_amount(unsigned long qd, bool up)
+{
+	return max(up ? qd >> SCALE_UP_FACTOR : qd >> SCALE_DOWN_FACTOR, 1UL);
+}
+
+/*
+ * Move the cookie of @lat_info up or down.  We scale in steps of a fraction
+ * of the queue depth, but never dig more than 2x the queue depth below the
+ * default, so that we can still find our way back up in reasonable time
+ * once the pressure is gone.
+ */
+static void scale_cookie_change(struct blk_iolatency *blkiolat,
+				struct child_latency_info *lat_info, bool up)
+{
+	unsigned long qd = blkiolat->q->nr_requests;
+	unsigned long scale = scale_amount(qd, up);
+	unsigned long old = atomic_read(&lat_info->scale_cookie);
+	unsigned long max_scale = qd << 1;
+	unsigned long diff = 0;
+
+	if (old < DEFAULT_SCALE_COOKIE)
+		diff = DEFAULT_SCALE_COOKIE - old;
+
+	if (up) {
+		if (scale + old > DEFAULT_SCALE_COOKIE)
+			atomic_set(&lat_info->scale_cookie,
+				   DEFAULT_SCALE_COOKIE);
+		else if (diff > qd)
+			atomic_inc(&lat_info->scale_cookie);
+		else
+			atomic_add(scale, &lat_info->scale_cookie);
+	} else {
+		if (diff > qd) {
+			if (diff < max_scale)
+				atomic_dec(&lat_info->scale_cookie);
+		} else {
+			atomic_sub(scale, &lat_info->scale_cookie);
+		}
+	}
+}
+
+/*
+ * Change the depth of @iolat.  Scaling down halves it, scaling up adds
+ * 1/16th of the queue depth, so we dial in slowly on a fair share.
+ */
+static void scale_change(struct iolatency_grp *iolat, bool up)
+{
+	unsigned long qd = iolat->blkiolat->q->nr_requests;
+	unsigned long scale = scale_amount(qd, up);
+	unsigned long old = iolat->max_depth;
+
+	if (old > qd)
+		old = qd;
+
+	if (up) {
+		if (old < qd) {
+			old += scale;
+			old = min(old, qd);
+			iolat->max_depth = old;
+			wake_up_all(&iolat->rq_wait.wait);
+		}
+	} else {
+		old >>= 1;
+		iolat->max_depth = max(old, 1UL);
+	}
+}
+
+/* Check our parent and see if the scale cookie has changed. */
+static void check_scale_change(struct iolatency_grp *iolat)
+{
+	struct blkcg_gq *blkg = lat_to_blkg(iolat);
+	struct iolatency_grp *parent;
+	struct child_latency_info *lat_info;
+	unsigned int our_cookie = atomic_read(&iolat->scale_cookie);
+	unsigned int cur_cookie, old;
+	u64 scale_lat;
+	int direction;
+
+	parent = blkg_to_lat(blkg->parent);
+	if (!parent)
+		return;
+
+	lat_info = &parent->child_lat;
+	cur_cookie = atomic_read(&lat_info->scale_cookie);
+	scale_lat = ACCESS_ONCE(lat_info->scale_lat);
+
+	if (cur_cookie < our_cookie)
+		direction = -1;
+	else if (cur_cookie > our_cookie)
+		direction = 1;
+	else
+		return;
+
+	/* Somebody beat us to the punch, just bail. */
+	old = atomic_cmpxchg(&iolat->scale_cookie, our_cookie, cur_cookie);
+	if (old != our_cookie)
+		return;
+
+	if (direction < 0 && iolat->min_lat_nsec) {
+		u64 samples_thresh;
+
+		/* we only give way to groups with a tighter target */
+		if (!scale_lat || iolat->min_lat_nsec <= scale_lat)
+			return;
+
+		/*
+		 * Sometimes the protected group is its own worst enemy.
+		 * Instead of punishing a group that did 5% or less of the
+		 * IO in the last window, skip this scale down event.
+		 */
+		samples_thresh = div64_u64(lat_info->nr_samples * 5, 100);
+		if (iolat->nr_samples <= samples_thresh)
+			return;
+	}
+
+	/* We're back to the default cookie, unthrottle all the things. */
+	if (cur_cookie == DEFAULT_SCALE_COOKIE) {
+		iolat->max_depth = UINT_MAX;
+		wake_up_all(&iolat->rq_wait.wait);
+		return;
+	}
+
+	scale_change(iolat, direction > 0);
+}
+
+/*
+ * Evaluate the window that just ended for @iolat and adjust the scale of
+ * its siblings if needed.  Only called by the one completion that claimed
+ * the end of the window.
+ */
+static void iolatency_check_latencies(struct iolatency_grp *iolat, u64 now)
+{
+	struct blkcg_gq *blkg = lat_to_blkg(iolat);
+	struct iolatency_grp *parent;
+	struct child_latency_info *lat_info;
+	unsigned long flags;
+	u64 total, mean;
+	unsigned int nr;
+	bool ok;
+
+	total = atomic64_xchg(&iolat->lat_total, 0);
+	nr = atomic_xchg(&iolat->nr_lat, 0);
+
+	parent = blkg_to_lat(blkg->parent);
+	if (!parent || !nr)
+		return;
+
+	lat_info = &parent->child_lat;
+	mean = div64_u64(total, nr);
+	ok = mean <= iolat->min_lat_nsec;
+
+	/* Everything is ok and we don't need to adjust the scale. */
+	if (ok && atomic_read(&lat_info->scale_cookie) == DEFAULT_SCALE_COOKIE)
+		return;
+
+	spin_lock_irqsave(&lat_info->lock, flags);
+
+	lat_info->nr_samples -= iolat->nr_samples;
+	lat_info->nr_samples += nr;
+	iolat->nr_samples = nr;
+
+	if (lat_info->last_scale_event >= now ||
+	    now - lat_info->last_scale_event < BLKIOLATENCY_MIN_ADJUST_TIME)
+		goto out;
+
+	if (ok) {
+		if (nr < BLKIOLATENCY_MIN_GOOD_SAMPLES)
+			goto out;
+		if (lat_info->scale_grp == iolat) {
+			lat_info->last_scale_event = now;
+			scale_cookie_change(iolat->blkiolat, lat_info, true);
+		}
+	} else if (lat_info->scale_lat == 0 ||
+		   lat_info->scale_lat >= iolat->min_lat_nsec) {
+		lat_info->last_scale_event = now;
+		if (!lat_info->scale_grp ||
+		    lat_info->scale_lat > iolat->min_lat_nsec) {
+			lat_info->scale_lat = iolat->min_lat_nsec;
+			lat_info->scale_grp = iolat;
+		}
+		scale_cookie_change(iolat->blkiolat, lat_info, false);
+	}
+out:
+	spin_unlock_irqrestore(&lat_info->lock, flags);
+}
+
+static inline bool iolatency_may_queue(struct iolatency_grp *iolat,
+				       wait_queue_t *wait)
+{
+	struct rq_wait *rqw = &iolat->rq_wait;
+
+	/*
+	 * If the waitqueue is already active and we are not the next
+	 * in line to be woken up, wait for our turn.
+	 */
+	if (waitqueue_active(&rqw->wait) &&
+	    rqw->wait.task_list.next != &wait->task_list)
+		return false;
+
+	return rq_wait_inc_below(rqw, iolat->max_depth);
+}
+
+static void __blkcg_iolatency_throttle(struct iolatency_grp *iolat,
+				       bool issue_as_root, spinlock_t *lock)
+	__releases(lock)
+	__acquires(lock)
+{
+	struct rq_wait *rqw = &iolat->rq_wait;
+	DEFINE_WAIT(wait);
+
+	if (issue_as_root) {
+		atomic_inc(&rqw->inflight);
+		return;
+	}
+
+	if (iolatency_may_queue(iolat, &wait))
+		return;
+
+	do {
+		prepare_to_wait_exclusive(&rqw->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+
+		if (iolatency_may_queue(iolat, &wait))
+			break;
+
+		if (lock) {
+			spin_unlock_irq(lock);
+			io_schedule();
+			spin_lock_irq(lock);
+		} else
+			io_schedule();
+	} while (1);
+
+	finish_wait(&rqw->wait, &wait);
+}
+
+/*
+ * The legacy request path calls in here with queue_lock held, blk-mq
+ * never does.
+ */
+static void iolatency_put_blkg(struct request_queue *q, struct blkcg_gq *blkg)
+{
+	unsigned long flags;
+
+	if (!q->mq_ops) {
+		blkg_put(blkg);
+		return;
+	}
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	blkg_put(blkg);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+/* give back the slot taken at every level by blk_iolatency_throttle() */
+static void iolatency_release(struct blkcg_gq *blkg)
+{
+	for (; blkg->parent; blkg = blkg->parent) {
+		struct rq_wait *rqw = &blkg_to_lat(blkg)->rq_wait;
+
+		atomic_dec(&rqw->inflight);
+		if (waitqueue_active(&rqw->wait))
+			wake_up(&rqw->wait);
+	}
+}
+
+/**
+ * blk_iolatency_throttle - charge a bio against its cgroup's depth limits
+ * @q: request_queue the bio is headed for
+ * @bio: bio about to be turned into a request
+ * @lock: queue_lock if the caller holds it, %NULL otherwise
+ *
+ * Takes one inflight slot at every non-root level of @bio's cgroup,
+ * sleeping while any level is at its depth limit.  If @lock is given it
+ * is dropped around the sleep.  Returns the blkg that was charged, with a
+ * reference held, or %NULL if nothing was.  The caller hands it to
+ * blk_iolatency_track() once it has a request, or to
+ * blk_iolatency_cancel() if it fails to get one.
+ */
+struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+					struct bio *bio, spinlock_t *lock)
+{
+	struct blk_iolatency *blkiolat = q->blkiolat;
+	struct blkcg_gq *blkg, *pos;
+	struct blkcg *blkcg;
+	bool issue_as_root;
+
+	if (!blkiolat || !atomic_read(&blkiolat->enabled))
+		return NULL;
+
+	rcu_read_lock();
+	blkcg = bio_blkcg(bio);
+	if (blkcg == &blkcg_root) {
+		rcu_read_unlock();
+		return NULL;
+	}
+
+	if (!lock)
+		spin_lock_irq(q->queue_lock);
+	blkg = blkg_lookup_create(blkcg, q);
+	if (IS_ERR(blkg))
+		blkg = NULL;
+	else
+		blkg_get(blkg);
+	if (!lock)
+		spin_unlock_irq(q->queue_lock);
+	rcu_read_unlock();
+
+	if (!blkg)
+		return NULL;
+
+	issue_as_root = (bio->bi_rw & (REQ_META | REQ_PRIO)) ||
+			(current->flags & PF_MEMALLOC);
+
+	for (pos = blkg; pos->parent; pos = pos->parent) {
+		struct iolatency_grp *iolat = blkg_to_lat(pos);
+
+		check_scale_change(iolat);
+		__blkcg_iolatency_throttle(iolat, issue_as_root, lock);
+	}
+
+	return blkg;
+}
+
+/**
+ * blk_iolatency_track - attach the charged blkg to the new request
+ * @rq: request allocated for the throttled bio
+ * @blkg: return value of blk_iolatency_throttle()
+ */
+void blk_iolatency_track(struct request *rq, struct blkcg_gq *blkg)
+{
+	rq->iolat_blkg = blkg;
+}
+
+/**
+ * blk_iolatency_cancel - undo blk_iolatency_throttle()
+ * @q: request_queue the bio was headed for
+ * @blkg: return value of blk_iolatency_throttle()
+ *
+ * Called when no request could be allocated for the bio.
+ */
+void blk_iolatency_cancel(struct request_queue *q, struct blkcg_gq *blkg)
+{
+	if (!blkg)
+		return;
+
+	iolatency_release(blkg);
+	iolatency_put_blkg(q, blkg);
+}
+
+static bool iolatency_rq_started(struct request *rq)
+{
+	if (rq->q->mq_ops)
+		return test_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+	return rq->cmd_flags & REQ_STARTED;
+}
+
+/**
+ * blk_iolatency_done - account a finished request
+ * @rq: request being freed
+ *
+ * Records the latency of @rq at every level with a target, releases its
+ * inflight slots and drops the blkg reference.  Safe to call more than
+ * once for the same request.
+ */
+void blk_iolatency_done(struct request *rq)
+{
+	struct blkcg_gq *blkg = rq->iolat_blkg, *pos;
+	u64 start, lat = 0, now;
+
+	if (!blkg)
+		return;
+	rq->iolat_blkg = NULL;
+
+	/*
+	 * Requests that were merged away or never made it to the driver
+	 * say nothing about the latency the device gives us, and neither
+	 * does IO that was issued as root.
+	 */
+	start = rq_start_time_ns(rq);
+	if (iolatency_rq_started(rq) &&
+	    !(rq->cmd_flags & (REQ_META | REQ_PRIO))) {
+		u64 clock = sched_clock();
+
+		if (clock > start)
+			lat = clock - start;
+	}
+
+	now = ktime_to_ns(ktime_get());
+	for (pos = blkg; pos->parent; pos = pos->parent) {
+		struct iolatency_grp *iolat = blkg_to_lat(pos);
+		u64 window_start;
+
+		if (!lat || !iolat->min_lat_nsec)
+			continue;
+
+		atomic64_add(lat, &iolat->lat_total);
+		atomic_inc(&iolat->nr_lat);
+
+		window_start = atomic64_read(&iolat->window_start);
+		if (now > window_start &&
+		    now - window_start >= iolat->cur_win_nsec &&
+		    atomic64_cmpxchg(&iolat->window_start, window_start,
+				     now) == window_start)
+			iolatency_check_latencies(iolat, now);
+	}
+
+	iolatency_release(blkg);
+	iolatency_put_blkg(rq->q, blkg);
+}
+
+/*
+ * Groups that caused a scale down may simply stop doing IO, and then
+ * nobody would ever scale their siblings back up.  Once a second, walk
+ * the queue and nudge every scaled down cookie back towards the default.
+ */
+static void blkiolatency_timer_fn(unsigned long data)
+{
+	struct blk_iolatency *blkiolat = (struct blk_iolatency *)data;
+	struct request_queue *q = blkiolat->q;
+	struct blkcg_gq *blkg;
+	unsigned long flags;
+	u64 now = ktime_to_ns(ktime_get());
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	list_for_each_entry(blkg, &q->blkg_list, q_node) {
+		struct iolatency_grp *iolat = blkg_to_lat(blkg);
+		struct child_latency_info *lat_info;
+
+		if (!iolat)
+			continue;
+
+		lat_info = &iolat->child_lat;
+		if (atomic_read(&lat_info->scale_cookie) >= DEFAULT_SCALE_COOKIE)
+			continue;
+
+		spin_lock(&lat_info->lock);
+		if (lat_info->last_scale_event >= now)
+			goto next;
+
+		/*
+		 * We scaled down but don't have a scale_grp, scale up and
+		 * carry on.
+		 */
+		if (!lat_info->scale_grp) {
+			scale_cookie_change(blkiolat, lat_info, true);
+			goto next;
+		}
+
+		/*
+		 * It's been 5 seconds since our last scale event, clear the
+		 * scale grp in case the group that needed the scale down
+		 * isn't doing any IO currently.
+		 */
+		if (now - lat_info->last_scale_event >= 5ULL * NSEC_PER_SEC)
+			lat_info->scale_grp = NULL;
+next:
+		spin_unlock(&lat_info->lock);
+	}
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	if (atomic_read(&blkiolat->enabled))
+		mod_timer(&blkiolat->timer, jiffies + HZ);
+}
+
+/* forget any scale down our parent did on behalf of @blkg */
+static void iolatency_clear_scaling(struct blkcg_gq *blkg)
+{
+	struct iolatency_grp *parent = blkg_to_lat(blkg->parent);
+	struct child_latency_info *lat_info;
+
+	if (!parent)
+		return;
+
+	lat_info = &parent->child_lat;
+	spin_lock(&lat_info->lock);
+	atomic_set(&lat_info->scale_cookie, DEFAULT_SCALE_COOKIE);
+	lat_info->last_scale_event = 0;
+	lat_info->scale_grp = NULL;
+	lat_info->scale_lat = 0;
+	spin_unlock(&lat_info->lock);
+}
+
+/*
+ * The last target on @q went away, let every group run at full depth
+ * again.  Called with queue_lock held.
+ */
+static void iolatency_reset_all(struct request_queue *q)
+{
+	struct blkcg_gq *blkg;
+
+	lockdep_assert_held(q->queue_lock);
+
+	list_for_each_entry(blkg, &q->blkg_list, q_node) {
+		struct iolatency_grp *iolat = blkg_to_lat(blkg);
+
+		if (!iolat)
+			continue;
+
+		iolat->max_depth = UINT_MAX;
+		atomic_set(&iolat->scale_cookie, DEFAULT_SCALE_COOKIE);
+		atomic_set(&iolat->child_lat.scale_cookie,
+			   DEFAULT_SCALE_COOKIE);
+		wake_up_all(&iolat->rq_wait.wait);
+	}
+}
+
+/* Called with queue_lock held. */
+static void iolatency_set_min_lat_nsec(struct blkcg_gq *blkg, u64 val)
+{
+	struct iolatency_grp *iolat = blkg_to_lat(blkg);
+	struct blk_iolatency *blkiolat = iolat->blkiolat;
+	u64 oldval = iolat->min_lat_nsec;
+
+	iolat->min_lat_nsec = val;
+	iolat->cur_win_nsec = clamp_t(u64, val << 4,
+				      BLKIOLATENCY_MIN_WIN_SIZE,
+				      BLKIOLATENCY_MAX_WIN_SIZE);
+
+	if (!oldval && val) {
+		if (atomic_inc_return(&blkiolat->enabled) == 1)
+			mod_timer(&blkiolat->timer, jiffies + HZ);
+	} else if (oldval && !val) {
+		if (atomic_dec_and_test(&blkiolat->enabled))
+			iolatency_reset_all(blkg->q);
+	}
+}
+
+static u64 iolatency_prfill_limit(struct seq_file *sf,
+				  struct blkg_policy_data *pd, int off)
+{
+	struct iolatency_grp *iolat = pd_to_lat(pd);
+
+	if (!iolat->min_lat_nsec)
+		return 0;
+	return __blkg_prfill_u64(sf, pd,
+				 div_u64(iolat->min_lat_nsec, NSEC_PER_USEC));
+}
+
+static int iolatency_print_limit(struct cgroup *cgrp, struct cftype *cft,
+				 struct seq_file *sf)
+{
+	blkcg_print_blkgs(sf, cgroup_to_blkcg(cgrp), iolatency_prfill_limit,
+			  &blkcg_policy_iolatency, cft->private, false);
+	return 0;
+}
+
+static int iolatency_set_limit(struct cgroup *cgrp, struct cftype *cft,
+			       const char *buf)
+{
+	struct blkcg *blkcg = cgroup_to_blkcg(cgrp);
+	struct blkg_conf_ctx ctx;
+	int ret;
+
+	ret = blkg_conf_prep(blkcg, &blkcg_policy_iolatency, buf, &ctx);
+	if (ret)
+		return ret;
+
+	if (ctx.v > div_u64(U64_MAX, NSEC_PER_USEC)) {
+		ret = -ERANGE;
+		goto out;
+	}
+
+	if (blkg_to_lat(ctx.blkg)->min_lat_nsec != ctx.v * NSEC_PER_USEC) {
+		iolatency_set_min_lat_nsec(ctx.blkg, ctx.v * NSEC_PER_USEC);
+		iolatency_clear_scaling(ctx.blkg);
+	}
+out:
+	blkg_conf_finish(&ctx);
+	return ret;
+}
+
+static struct cftype iolatency_files[] = {
+	{
+		.name = "latency.target_device",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_seq_string = iolatency_print_limit,
+		.write_string = iolatency_set_limit,
+		.max_write_len = 256,
+	},
+	{ }	/* terminate */
+};
+
+static void iolatency_pd_init(struct blkcg_gq *blkg)
+{
+	struct iolatency_grp *iolat = blkg_to_lat(blkg);
+
+	iolat->blkiolat = blkg->q->blkiolat;
+	init_waitqueue_head(&iolat->rq_wait.wait);
+	atomic_set(&iolat->rq_wait.inflight, 0);
+	iolat->max_depth = UINT_MAX;
+	iolat->cur_win_nsec = BLKIOLATENCY_MIN_WIN_SIZE;
+	atomic64_set(&iolat->window_start, ktime_to_ns(ktime_get()));
+	atomic_set(&iolat->scale_cookie, DEFAULT_SCALE_COOKIE);
+
+	spin_lock_init(&iolat->child_lat.lock);
+	atomic_set(&iolat->child_lat.scale_cookie, DEFAULT_SCALE_COOKIE);
+}
+
+static void iolatency_pd_online(struct blkcg_gq *blkg)
+{
+	struct iolatency_grp *iolat = blkg_to_lat(blkg);
+	struct iolatency_grp *parent = blkg_to_lat(blkg->parent);
+
+	/* start out at our parent's current scale */
+	if (parent)
+		atomic_set(&iolat->scale_cookie,
+			   atomic_read(&parent->child_lat.scale_cookie));
+}
+
+static void iolatency_pd_offline(struct blkcg_gq *blkg)
+{
+	if (!blkg->parent)
+		return;
+
+	iolatency_set_min_lat_nsec(blkg, 0);
+	iolatency_clear_scaling(blkg);
+}
+
+static struct blkcg_policy blkcg_policy_iolatency = {
+	.pd_size		= sizeof(struct iolatency_grp),
+	.cftypes		= iolatency_files,
+
+	.pd_init_fn		= iolatency_pd_init,
+	.pd_online_fn		= iolatency_pd_online,
+	.pd_offline_fn		= iolatency_pd_offline,
+};
+
+int blk_iolatency_init(struct request_queue *q)
+{
+	struct blk_iolatency *blkiolat;
+	int ret;
+
+	blkiolat = kzalloc_node(sizeof(*blkiolat), GFP_KERNEL, q->node);
+	if (!blkiolat)
+		return -ENOMEM;
+
+	blkiolat->q = q;
+	setup_timer(&blkiolat->timer, blkiolatency_timer_fn,
+		    (unsigned long)blkiolat);
+	q->blkiolat = blkiolat;
+
+	ret = blkcg_activate_policy(q, &blkcg_policy_iolatency);
+	if (ret) {
+		q->blkiolat = NULL;
+		kfree(blkiolat);
+	}
+	return ret;
+}
+
+void blk_iolatency_exit(struct request_queue *q)
+{
+	struct blk_iolatency *blkiolat = q->blkiolat;
+
+	BUG_ON(!blkiolat);
+	del_timer_sync(&blkiolat->timer);
+	blkcg_deactivate_policy(q, &blkcg_policy_iolatency);
+	q->blkiolat = NULL;
+	kfree(blkiolat);
+}
+
+static int __init iolatency_init(void)
+{
+	return blkcg_policy_register(&blkcg_policy_iolatency);
+}
+
+module_init(iolatency_init);
@@ -80,6 +80,7 @@ static const char *const blk_queue_flag_name[] = {
 	QUEUE_FLAG_NAME(POLL_STATS),
 	QUEUE_FLAG_NAME(PREEMPT_ONLY),
 	QUEUE_FLAG_NAME(QUIESCED),
+	QUEUE_FLAG_NAME(POLL),
 };
 #undef QUEUE_FLAG_NAME
 
@@ -130,6 +131,30 @@ inval:
 	return count;
 }
 
+static void print_stat(struct seq_file *m, struct blk_rq_stat *stat)
+{
+	if (stat->nr_samples) {
+		seq_printf(m, "samples=%d, mean=%lld, min=%llu, max=%llu",
+			   stat->nr_samples, stat->mean, stat->min, stat->max);
+	} else {
+		seq_puts(m, "samples=0");
+	}
+}
+
+static int queue_poll_stat_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+
+	seq_puts(m, "read: ");
+	print_stat(m, &q->poll_stat[READ]);
+	seq_puts(m, "\n");
+
+	seq_puts(m, "write: ");
+	print_stat(m, &q->poll_stat[WRITE]);
+	seq_puts(m, "\n");
+	return 0;
+}
+
 #define HCTX_STATE_NAME(name) [BLK_MQ_S_##name] = #name
 static const char *const hctx_state_name[] = {
 	HCTX_STATE_NAME(STOPPED),
@@ -469,6 +494,25 @@ static ssize_t hctx_dispatched_write(void *data, const char __user *buf,
 	return count;
 }
 
+static int hctx_io_poll_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+
+	seq_printf(m, "considered=%lu\n", hctx->poll_considered);
+	seq_printf(m, "invoked=%lu\n", hctx->poll_invoked);
+	seq_printf(m, "success=%lu\n", hctx->poll_success);
+	return 0;
+}
+
+static ssize_t hctx_io_poll_write(void *data, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+
+	hctx->poll_considered = hctx->poll_invoked = hctx->poll_success = 0;
+	return count;
+}
+
 static int hctx_queued_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -584,6 +628,24 @@ static ssize_t ctx_merged_write(void *data, const char __user *buf,
 	return count;
 }
 
+static int ctx_merge_stats_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_ctx *ctx = data;
+
+	seq_printf(m, "hash %lu\nscan %lu\nmiss %lu\n", ctx->rq_merge_hash,
+		   ctx->rq_merge_scan, ctx->rq_merge_miss);
+	return 0;
+}
+
+static ssize_t ctx_merge_stats_write(void *data, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct blk_mq_ctx *ctx = data;
+
+	ctx->rq_merge_hash = ctx->rq_merge_scan = ctx->rq_merge_miss = 0;
+	return count;
+}
+
 static int ctx_completed_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_ctx *ctx = data;
@@ -684,6 +746,7 @@ const struct file_operations blk_mq_debugfs_fops = {
 };
 
 static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
+	{"poll_stat", 0400, queue_poll_stat_show},
 	{"state", 0600, queue_state_show, queue_state_write},
 	{"requeue_list", 0400, .seq_ops = &queue_requeue_list_seq_ops},
 	{},
@@ -700,6 +763,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_hctx_attrs[] = {
 	{"sched_tags", 0400, hctx_sched_tags_show},
 	{"sched_tags_bitmap", 0400, hctx_sched_tags_bitmap_show},
 	{"dispatched", 0600, hctx_dispatched_show, hctx_dispatched_write},
+	{"io_poll", 0600, hctx_io_poll_show, hctx_io_poll_write},
 	{"queued", 0600, hctx_queued_show, hctx_queued_write},
 	{"run", 0600, hctx_run_show, hctx_run_write},
 	{"active", 0400, hctx_active_show},
@@ -711,6 +775,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_ctx_attrs[] = {
 	{"rq_list", 0400, .seq_ops = &ctx_rq_list_seq_ops},
 	{"dispatched", 0600, ctx_dispatched_show, ctx_dispatched_write},
 	{"merged", 0600, ctx_merged_show, ctx_merged_write},
+	{"merge_stats", 0600, ctx_merge_stats_show, ctx_merge_stats_write},
 	{"completed", 0600, ctx_completed_show, ctx_completed_write},
 	{},
 };
@@ -449,20 +449,28 @@ EXPORT_SYMBOL_GPL(blk_mq_sched_try_merge);
 bool __blk_mq_sched_bio_merge(struct request_queue *q, struct bio *bio)
 {
 	struct elevator_queue *e = q->elevator;
-
-	if (e->aux->ops.mq.bio_merge) {
         //q->queue_ctxõÿCPUר
-		struct blk_mq_ctx *ctx = blk_mq_get_ctx(q);
+	struct blk_mq_ctx *ctx = blk_mq_get_ctx(q);
         //ctx->cpu󶨵CPUţȥq->queue_hw_ctx[]ѰӲ
-		struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, ctx->cpu);
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, ctx->cpu);
+	bool ret = false;
 
+	if (e->aux->ops.mq.bio_merge) {
 		blk_mq_put_ctx(ctx);
 //IOǷпԺϲreqҵbioǰϲreqᴥκϲԺϲreqIO㷨
 //ϲкӲûаëǮĹϵ
 		return e->aux->ops.mq.bio_merge(hctx, bio);//mq-deadline㷨dd_bio_merge
 	}
 
-	return false;
+	/* schedulers that keep requests on the software queues merge there */
+	if (hctx->flags & BLK_MQ_F_SHOULD_MERGE) {
+		spin_lock(&ctx->lock);
+		ret = blk_mq_attempt_merge(q, ctx, bio);
+		spin_unlock(&ctx->lock);
+	}
+
+	blk_mq_put_ctx(ctx);
+	return ret;
 }
 //ȳԽrqϲq->last_mergeٳԽrqϲhashеĳһ__rqϲrqʼַq->last_merge__rq
 //ַǵblk_attempt_req_merge()кϲIOʹʵݡʹdeadline㷨ºϲreq
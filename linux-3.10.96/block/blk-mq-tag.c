@@ -283,6 +283,68 @@ void blk_mq_put_tag(struct blk_mq_hw_ctx *hctx, struct blk_mq_tags *tags,
 	}
 }
 
+/* Clear all bits of @mask in @addr with a single atomic operation */
+static void blk_mq_clear_tag_word(unsigned long *addr, unsigned long mask)
+{
+	unsigned long old, new;
+
+	do {
+		old = ACCESS_ONCE(*addr);
+		new = old & ~mask;
+	} while (cmpxchg(addr, old, new) != old);
+}
+
+/*
+ * Free @nr_tags tags at once, for batched completions.  Bits that live in
+ * the same bitmap word are cleared together, so a batch of adjacent tags
+ * costs one atomic per word instead of one per tag.
+ */
+void blk_mq_put_tags(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
+		     int *tag_array, int nr_tags)
+{
+	struct sbitmap_queue *sbq = &tags->bitmap_tags;
+	struct sbitmap *sb = &sbq->sb;
+	unsigned long *addr = NULL, mask = 0;
+	unsigned int nr_cleared = 0, last = 0;
+	int i;
+
+	for (i = 0; i < nr_tags; i++) {
+		unsigned int tag = tag_array[i];
+		unsigned long *this_addr;
+
+		if (blk_mq_tag_is_reserved(tags, tag)) {
+			BUG_ON(tag >= tags->nr_reserved_tags);
+			sbitmap_queue_clear(&tags->breserved_tags, tag,
+					    ctx->cpu);
+			continue;
+		}
+
+		last = tag - tags->nr_reserved_tags;
+		BUG_ON(last >= tags->nr_tags);
+
+		this_addr = __sbitmap_word(sb, last);
+		if (this_addr != addr) {
+			if (mask)
+				blk_mq_clear_tag_word(addr, mask);
+			addr = this_addr;
+			mask = 0;
+		}
+		mask |= 1UL << SB_NR_TO_BIT(sb, last);
+		nr_cleared++;
+	}
+
+	if (!nr_cleared)
+		return;
+	blk_mq_clear_tag_word(addr, mask);
+
+	/* cmpxchg() is a full barrier, the bits are visible to waiters */
+	while (nr_cleared--)
+		sbitmap_queue_wake_up(sbq);
+
+	if (likely(!sbq->round_robin && last < sb->depth))
+		*per_cpu_ptr(sbq->alloc_hint, ctx->cpu) = last;
+}
+
 struct bt_iter_data {
 	struct blk_mq_hw_ctx *hctx;
 	busy_iter_fn *fn;
@@ -32,6 +32,7 @@
 #include "blk-mq-tag.h"
 #include "blk-mq-sched.h"
 #include "blk-stat.h"
+#include "blk-wbt.h"
 
 static DEFINE_MUTEX(all_q_mutex);
 static LIST_HEAD(all_q_list);
@@ -298,6 +299,9 @@ void blk_mq_rq_ctx_init(struct request_queue *q, struct blk_mq_ctx *ctx,
 	rq->rl = NULL;
 	set_start_time_ns(rq);
 	rq->io_start_time_ns = 0;
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	rq->iolat_blkg = NULL;
 #endif
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -450,17 +454,31 @@ blk_mq_sched_completed_request(struct request *rq)
 		e->aux->ops.mq.completed_request(rq);
 }
 
-void __blk_mq_finish_request(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx,
-			     struct request *rq)
+/*
+ * Everything __blk_mq_finish_request() does to @rq short of giving its
+ * tags back, so that blk_mq_end_request_batch() can return those in bulk.
+ */
+static void __blk_mq_release_request(struct blk_mq_hw_ctx *hctx,
+				     struct request *rq)
 {
-	const int sched_tag = rq_aux(rq)->internal_tag;
-	struct request_queue *q = rq->q;
-
 	if (rq->cmd_flags & REQ_MQ_INFLIGHT)
 		atomic_dec(&hctx->nr_active);
+
+	wbt_done(rq->q->rq_wb, &rq_aux(rq)->issue_stat);
+	blk_iolatency_done(rq);
 	rq->cmd_flags = 0;
 
 	clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
+	clear_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags);
+}
+
+void __blk_mq_finish_request(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx,
+			     struct request *rq)
+{
+	const int sched_tag = rq_aux(rq)->internal_tag;
+	struct request_queue *q = rq->q;
+
+	__blk_mq_release_request(hctx, rq);
 	if (rq->tag != -1)
 		blk_mq_put_tag(hctx, hctx->tags, ctx, rq->tag);
 	if (sched_tag != -1)
@@ -496,6 +514,8 @@ inline void __blk_mq_end_request(struct request *rq, int error)
 	blk_account_io_done(rq);
 
 	if (rq->end_io) {
+		wbt_done(rq->q->rq_wb, &rq_aux(rq)->issue_stat);
+		blk_iolatency_done(rq);
 		rq->end_io(rq, error);
 	} else {
 		if (unlikely(blk_bidi_rq(rq)))
@@ -524,38 +544,47 @@ static void __blk_mq_complete_request_remote(void *data)
 	rq->q->softirq_done_fn(rq);
 }
 
-static void blk_mq_ipi_complete_request(struct request *rq)
+/*
+ * Return the cpu the ->softirq_done_fn() of @rq should run on, when it is
+ * being completed on @cpu.
+ */
+static int blk_mq_complete_cpu(struct request *rq, int cpu)
 {
-	struct blk_mq_ctx *ctx = rq->mq_ctx;
-	bool shared = false;
-	int cpu;
+	struct request_queue *q = rq->q;
+	int target = rq->mq_ctx->cpu;
 
-	if (!test_bit(QUEUE_FLAG_SAME_COMP, &rq->q->queue_flags)) {
-		rq->q->softirq_done_fn(rq);
-		return;
-	}
+	if (!test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags))
+		return cpu;
+	if (cpu == target || !cpu_online(target))
+		return cpu;
+	if (!test_bit(QUEUE_FLAG_SAME_FORCE, &q->queue_flags) &&
+	    cpus_share_cache(cpu, target))
+		return cpu;
 
-	cpu = get_cpu();
-	if (!test_bit(QUEUE_FLAG_SAME_FORCE, &rq->q->queue_flags))
-		shared = cpus_share_cache(cpu, ctx->cpu);
+	return target;
+}
 
-	if (cpu != ctx->cpu && !shared && cpu_online(ctx->cpu)) {
+static void blk_mq_ipi_complete_request(struct request *rq)
+{
+	int cpu, target;
+
+	cpu = get_cpu();
+	target = blk_mq_complete_cpu(rq, cpu);
+	if (target != cpu) {
 		rq->csd.func = __blk_mq_complete_request_remote;
 		rq->csd.info = rq;
 		rq->csd.flags = 0;
-		smp_call_function_single_async(ctx->cpu, &rq->csd);
+		smp_call_function_single_async(target, &rq->csd);
 	} else {
 		rq->q->softirq_done_fn(rq);
 	}
 	put_cpu();
 }
 
-static void blk_mq_stat_add(struct request *rq)
+static void blk_mq_stat_add(struct request *rq, u64 now)
 {
-	if (rq->cmd_flags & REQ_STATS) {
-		blk_mq_poll_stats_start(rq->q);
-		blk_stat_add(rq);
-	}
+	blk_mq_poll_stats_start(rq->q);
+	blk_stat_add(rq, now);
 }
 
 static void __blk_mq_complete_request(struct request *rq, bool sync)
@@ -565,7 +594,8 @@ static void __blk_mq_complete_request(struct request *rq, bool sync)
 	if (rq_aux(rq)->internal_tag != -1)
 		blk_mq_sched_completed_request(rq);
 
-	blk_mq_stat_add(rq);
+	if (rq->cmd_flags & REQ_STATS)
+		blk_mq_stat_add(rq, ktime_to_ns(ktime_get()));
 
 	if (!q->softirq_done_fn)
 		blk_mq_end_request(rq, rq->errors);
@@ -625,6 +655,199 @@ void blk_mq_complete_request_sync(struct request *rq, int error)
 }
 EXPORT_SYMBOL_GPL(blk_mq_complete_request_sync);
 
+/**
+ * blk_mq_add_to_batch - queue a completed request on a completion batch
+ * @rq:		the request being processed
+ * @iob:	batch to add it to
+ * @error:	completion status of @rq
+ *
+ * Description:
+ *	Drivers reaping many completions at once can collect them in @iob
+ *	and end them all with blk_mq_complete_batch(), instead of calling
+ *	blk_mq_complete_request() on each.  Requests that failed or that
+ *	have an ->end_io() are not batched, false is returned for those and
+ *	the driver has to complete them the normal way.
+ **/
+bool blk_mq_add_to_batch(struct request *rq, struct io_comp_batch *iob,
+			 int error)
+{
+	if (error || rq->end_io || blk_bidi_rq(rq))
+		return false;
+
+	if (unlikely(blk_should_fake_timeout(rq->q)))
+		return true;
+	if (!blk_mark_rq_complete(rq)) {
+		rq->errors = 0;
+		list_add_tail(&rq->queuelist, &iob->req_list);
+	}
+	return true;
+}
+EXPORT_SYMBOL_GPL(blk_mq_add_to_batch);
+
+/*
+ * Batched IPI handler, @data is the leader of a list of requests that all
+ * complete on this cpu.  The leader's queuelist is the list head.
+ */
+static void __blk_mq_complete_batch_remote(void *data)
+{
+	struct request *leader = data, *rq, *next;
+
+	list_for_each_entry_safe(rq, next, &leader->queuelist, queuelist) {
+		list_del_init(&rq->queuelist);
+		rq->q->softirq_done_fn(rq);
+	}
+	leader->q->softirq_done_fn(leader);
+}
+
+/**
+ * blk_mq_complete_batch - end I/O on all requests of a completion batch
+ * @iob:	batch filled by blk_mq_add_to_batch()
+ *
+ * Description:
+ *	Same as calling blk_mq_complete_request() on every request of @iob,
+ *	but the completion time for the stats is read once, requests that
+ *	have to complete on another cpu are sent there with one IPI per cpu,
+ *	and requests of queues without ->softirq_done_fn() are ended with
+ *	blk_mq_end_request_batch().
+ **/
+void blk_mq_complete_batch(struct io_comp_batch *iob)
+{
+	DEFINE_IO_COMP_BATCH(local);
+	struct request *rq, *next;
+	u64 now = 0;
+	int cpu;
+
+	list_for_each_entry(rq, &iob->req_list, queuelist) {
+		if (rq_aux(rq)->internal_tag != -1)
+			blk_mq_sched_completed_request(rq);
+		if (rq->cmd_flags & REQ_STATS) {
+			if (!now)
+				now = ktime_to_ns(ktime_get());
+			blk_mq_stat_add(rq, now);
+		}
+	}
+
+	cpu = get_cpu();
+	while (!list_empty(&iob->req_list)) {
+		struct request *leader;
+		int target;
+
+		leader = list_first_entry(&iob->req_list, struct request,
+					  queuelist);
+		list_del_init(&leader->queuelist);
+
+		if (!leader->q->softirq_done_fn) {
+			list_add_tail(&leader->queuelist, &local.req_list);
+			continue;
+		}
+
+		target = blk_mq_complete_cpu(leader, cpu);
+		if (target == cpu) {
+			leader->q->softirq_done_fn(leader);
+			continue;
+		}
+
+		/* everything else headed for @target rides on the same IPI */
+		list_for_each_entry_safe(rq, next, &iob->req_list, queuelist) {
+			if (rq->q == leader->q &&
+			    blk_mq_complete_cpu(rq, cpu) == target)
+				list_move_tail(&rq->queuelist,
+					       &leader->queuelist);
+		}
+
+		leader->csd.func = __blk_mq_complete_batch_remote;
+		leader->csd.info = leader;
+		leader->csd.flags = 0;
+		smp_call_function_single_async(target, &leader->csd);
+	}
+	put_cpu();
+
+	blk_mq_end_request_batch(&local);
+}
+EXPORT_SYMBOL_GPL(blk_mq_complete_batch);
+
+/*
+ * Requests that hold nothing but a driver tag can be freed in bulk by
+ * blk_mq_end_request_batch(), everything else goes through
+ * blk_mq_free_request().
+ */
+static bool blk_mq_can_batch_free(struct request *rq)
+{
+	return !rq->end_io && !blk_bidi_rq(rq) &&
+		rq_aux(rq)->internal_tag == -1 && rq->tag != -1 &&
+		!(rq->cmd_flags & (REQ_ELVPRIV | REQ_QUEUED));
+}
+
+static void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx,
+				   struct blk_mq_ctx *ctx, int *tags,
+				   int nr_tags)
+{
+	struct request_queue *q = hctx->queue;
+	int i;
+
+	blk_mq_put_tags(hctx->tags, ctx, tags, nr_tags);
+	blk_mq_sched_restart(hctx);
+	for (i = 0; i < nr_tags; i++)
+		blk_queue_exit(q);
+}
+
+#define TAG_COMP_BATCH		32
+
+/**
+ * blk_mq_end_request_batch - end and free all requests of a batch
+ * @iob:	batch of successfully completed requests
+ *
+ * Description:
+ *	Same as calling blk_mq_end_request(rq, 0) on every request of @iob,
+ *	but driver tags of the same software queue are given back together,
+ *	one bitmap update per word, and the hardware queue is restarted once
+ *	per group.  For drivers that end their requests without going
+ *	through ->softirq_done_fn().
+ **/
+void blk_mq_end_request_batch(struct io_comp_batch *iob)
+{
+	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	struct blk_mq_ctx *cur_ctx = NULL;
+	struct request *rq, *next;
+	int tags[TAG_COMP_BATCH], nr_tags = 0;
+
+	list_for_each_entry_safe(rq, next, &iob->req_list, queuelist) {
+		struct blk_mq_hw_ctx *hctx;
+
+		list_del_init(&rq->queuelist);
+
+		if (!blk_mq_can_batch_free(rq)) {
+			blk_mq_end_request(rq, 0);
+			continue;
+		}
+
+		if (blk_update_request(rq, 0, blk_rq_bytes(rq)))
+			BUG();
+		blk_account_io_done(rq);
+
+		/*
+		 * Tags are put back through their software queue, so the
+		 * batch must not span more than one ctx.
+		 */
+		hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+		if (nr_tags == TAG_COMP_BATCH ||
+		    (cur_ctx && cur_ctx != rq->mq_ctx)) {
+			blk_mq_flush_tag_batch(cur_hctx, cur_ctx, tags, nr_tags);
+			nr_tags = 0;
+		}
+		cur_hctx = hctx;
+		cur_ctx = rq->mq_ctx;
+
+		cur_ctx->rq_completed[rq_is_sync(rq)]++;
+		__blk_mq_release_request(hctx, rq);
+		tags[nr_tags++] = rq->tag;
+	}
+
+	if (nr_tags)
+		blk_mq_flush_tag_batch(cur_hctx, cur_ctx, tags, nr_tags);
+}
+EXPORT_SYMBOL_GPL(blk_mq_end_request_batch);
+
 int blk_mq_request_started(struct request *rq)
 {
 	return test_bit(REQ_ATOM_STARTED, &rq->atomic_flags);
@@ -646,6 +869,7 @@ void blk_mq_start_request(struct request *rq)
 	if (test_bit(QUEUE_FLAG_STATS, &q->queue_flags)) {
 		blk_stat_set_issue_time(&rq_aux(rq)->issue_stat);
 		rq->cmd_flags |= REQ_STATS;
+		wbt_issue(q->rq_wb, &rq_aux(rq)->issue_stat);
 	}
     //reqӵq->timeout_listq->timeout
 	blk_add_timer(rq);
@@ -694,6 +918,7 @@ static void __blk_mq_requeue_request(struct request *rq)
 	blk_mq_put_driver_tag(rq);
 
 	trace_block_rq_requeue(q, rq);
+	wbt_requeue(q->rq_wb, &rq_aux(rq)->issue_stat);
 
 	if (test_and_clear_bit(REQ_ATOM_STARTED, &rq->atomic_flags)) {
 		if (q->dma_drain_size && blk_rq_bytes(rq))
@@ -906,17 +1131,65 @@ static void blk_mq_timeout_work(struct work_struct *work)
 	blk_queue_exit(q);
 }
 
+static inline void blk_mq_ctx_hash_add(struct blk_mq_ctx *ctx,
+				       struct request *rq)
+{
+	if (rq_mergeable(rq))
+		hash_add(ctx->rq_hash, &rq->hash, rq_hash_key(rq));
+}
+
+static inline void blk_mq_ctx_hash_del(struct request *rq)
+{
+	hash_del(&rq->hash);
+}
+
 /*
- * Reverse check our software queue for entries that we could potentially
- * merge with. Currently includes a hand-wavy stop count of 8, to not spend
+ * The end sector changed after a back merge
+ */
+static inline void blk_mq_ctx_hash_reposition(struct blk_mq_ctx *ctx,
+					      struct request *rq)
+{
+	blk_mq_ctx_hash_del(rq);
+	blk_mq_ctx_hash_add(ctx, rq);
+}
+
+static struct request *blk_mq_ctx_hash_find(struct blk_mq_ctx *ctx,
+					    sector_t offset)
+{
+	struct request *rq;
+
+	hash_for_each_possible(ctx->rq_hash, rq, hash, offset)
+		if (rq_hash_key(rq) == offset)
+			return rq;
+
+	return NULL;
+}
+
+/*
+ * Look up a request ending where @bio starts through the end sector hash,
+ * so sequential streams back merge no matter how deep the software queue
+ * is. Then reverse check our software queue for the remaining merge
+ * candidates. Currently includes a hand-wavy stop count of 8, to not spend
  * too much time checking for merges.
  */
 //Ųѽαctx->rq_listϵreqȻreqܷbioǰߺϲ
-static bool blk_mq_attempt_merge(struct request_queue *q,
-				 struct blk_mq_ctx *ctx, struct bio *bio)
+bool blk_mq_attempt_merge(struct request_queue *q, struct blk_mq_ctx *ctx,
+			  struct bio *bio)
 {
 	struct request *rq;
 	int checked = 8;
+
+	rq = blk_mq_ctx_hash_find(ctx, bio->bi_sector);
+	if (rq && blk_rq_merge_ok(rq, bio) &&
+	    blk_try_merge(rq, bio) == ELEVATOR_BACK_MERGE &&
+	    blk_mq_sched_allow_merge(q, rq, bio) &&
+	    bio_attempt_back_merge(q, rq, bio)) {
+		blk_mq_ctx_hash_reposition(ctx, rq);
+		ctx->rq_merged++;
+		ctx->rq_merge_hash++;
+		return true;
+	}
+
     //αctx->rq_listϵreq
 	list_for_each_entry_reverse(rq, &ctx->rq_list, queuelist) {
 		int el_ret;
@@ -938,7 +1211,9 @@ static bool blk_mq_attempt_merge(struct request_queue *q,
         //ǰϲ
 		if (el_ret == ELEVATOR_BACK_MERGE) {
 			if (bio_attempt_back_merge(q, rq, bio)) {
+				blk_mq_ctx_hash_reposition(ctx, rq);
 				ctx->rq_merged++;
+				ctx->rq_merge_scan++;
 				return true;
 			}
 			break;
@@ -946,12 +1221,14 @@ static bool blk_mq_attempt_merge(struct request_queue *q,
 		} else if (el_ret == ELEVATOR_FRONT_MERGE) {
 			if (bio_attempt_front_merge(q, rq, bio)) {
 				ctx->rq_merged++;
+				ctx->rq_merge_scan++;
 				return true;
 			}
 			break;
 		}
 	}
 
+	ctx->rq_merge_miss++;
 	return false;
 }
 
@@ -965,8 +1242,11 @@ static bool flush_busy_ctx(struct sbitmap *sb, unsigned int bitnr, void *data)
 	struct flush_busy_ctx_data *flush_data = data;
 	struct blk_mq_hw_ctx *hctx = flush_data->hctx;
 	struct blk_mq_ctx *ctx = hctx->ctxs[bitnr];
+	struct request *rq;
 
 	spin_lock(&ctx->lock);
+	list_for_each_entry(rq, &ctx->rq_list, queuelist)
+		blk_mq_ctx_hash_del(rq);
     //hctx->ctxs[[bitnr]]ϵctx->rq_listreqתƵflush_data->listβȻctx->rq_list
 	list_splice_tail_init(&ctx->rq_list, flush_data->list);
 	sbitmap_clear_bit(sb, bitnr);
@@ -1009,6 +1289,7 @@ static bool dispatch_rq_from_ctx(struct sbitmap *sb, unsigned int bitnr,
 		dispatch_data->rq = list_entry_rq(ctx->rq_list.next);
         //޳req
 		list_del_init(&dispatch_data->rq->queuelist);
+		blk_mq_ctx_hash_del(dispatch_data->rq);
         //hctx->ctx_mapжӦı־λ
 		if (list_empty(&ctx->rq_list))
 			sbitmap_clear_bit(sb, bitnr);
@@ -1329,6 +1610,13 @@ bool blk_mq_dispatch_rq_list(struct request_queue *q, struct list_head *list,
 	}
     while (!list_empty(list));
 
+	/*
+	 * If we didn't flush the entire list, we could have told the
+	 * driver there was more coming, but that turned out to be a lie.
+	 */
+	if ((!list_empty(list) || errors) && queued)
+		blk_mq_commit_rqs(hctx);
+
     //ʲô?????һreq1??????
 	hctx->dispatched[queued_to_index(queued)]++;
 
@@ -1643,6 +1931,7 @@ static inline void __blk_mq_insert_req_list(struct blk_mq_hw_ctx *hctx,
 		list_add(&rq->queuelist, &ctx->rq_list);
 	else
 		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	blk_mq_ctx_hash_add(ctx, rq);
 }
 //req뵽ctx->rq_list,ӦӲhctx->ctx_mapbitλ1ʾ
 void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
@@ -1691,6 +1980,8 @@ void blk_mq_insert_requests(struct blk_mq_hw_ctx *hctx, struct blk_mq_ctx *ctx,
 	}
 
 	spin_lock(&ctx->lock);
+	list_for_each_entry(rq, list, queuelist)
+		blk_mq_ctx_hash_add(ctx, rq);
     //listĳԱ뵽ctx->rq_listߣȻlist0listԴԵǰ̵plug
 	list_splice_tail_init(list, &ctx->rq_list);
     //reqˣӦӲhctx->ctx_mapbitλ1ʾ
@@ -1788,6 +2079,8 @@ static void blk_mq_bio_to_request(struct request *rq, struct bio *bio)
 {
     //ֵreqʼַreqַrq->bio = rq->biotail=bio
 	init_request_from_bio(rq, bio);
+	if (bio_flagged(bio, BIO_HIPRI))
+		rq->cmd_flags |= REQ_HIPRI;
 
 	if (blk_do_io_stat(rq))
 		blk_account_io_start(rq, true);//ͳƴʹʵ
@@ -2019,6 +2312,8 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	unsigned int request_count = 0;
 	struct blk_plug *plug;
 	struct request *same_queue_rq = NULL;
+	unsigned int wb_acct;
+	struct blkcg_gq *iolat_blkg;
 
 	blk_queue_bounce(q, &bio);
 
@@ -2043,13 +2338,26 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	if (blk_mq_merge_bio(q, bio))
 		return;
 
+	wb_acct = wbt_wait(q->rq_wb, bio, NULL);
+	iolat_blkg = blk_iolatency_throttle(q, bio, NULL);
+
 	trace_block_getrq(q, bio, bio->bi_rw);
     
     /*Ӳصblk_mq_tagsṹstatic_rqs[]õеrequestȡʧӲIOɷ
       ֮ٳԴblk_mq_tagsṹstatic_rqs[]õеrequest*/
 	rq = blk_mq_sched_get_request(q, bio, bio->bi_rw, &data);//еûеȡreq
-	if (unlikely(!rq))
+	if (unlikely(!rq)) {
+		__wbt_done(q->rq_wb, wb_acct);
+		blk_iolatency_cancel(q, iolat_blkg);
 		return;
+	}
+
+	wbt_track(&rq_aux(rq)->issue_stat, wb_acct);
+	blk_iolatency_track(rq, iolat_blkg);
+
+	/* flush requests are reissued by the flush machinery, don't poll */
+	if (!is_flush_fua)
+		bio->bi_cookie = request_to_qc_t(data.hctx, rq);
     
     //ǰ̵blk_plug
 	plug = current->plug;
@@ -2329,12 +2637,15 @@ fail:
 static int blk_mq_hctx_cpu_offline(struct blk_mq_hw_ctx *hctx, int cpu)
 {
 	struct blk_mq_ctx *ctx;
+	struct request *rq;
 	LIST_HEAD(tmp);
 
 	ctx = __blk_mq_get_ctx(hctx->queue, cpu);
 
 	spin_lock(&ctx->lock);
 	if (!list_empty(&ctx->rq_list)) {
+		list_for_each_entry(rq, &ctx->rq_list, queuelist)
+			blk_mq_ctx_hash_del(rq);
 		list_splice_init(&ctx->rq_list, &tmp);
 		blk_mq_hctx_clear_pending(hctx, ctx);
 	}
@@ -2524,6 +2835,7 @@ static void blk_mq_init_cpu_queues(struct request_queue *q,
 		__ctx->cpu = i;
 		spin_lock_init(&__ctx->lock);
 		INIT_LIST_HEAD(&__ctx->rq_list);
+		hash_init(__ctx->rq_hash);
         //нṹblk_mq_ctxֵж
 		__ctx->queue = q;
 
@@ -2920,6 +3232,14 @@ struct request_queue *blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 	//nr_requestsΪ
 	q->nr_requests = set->queue_depth;
 
+	/*
+	 * Default to classic polling
+	 */
+	q->poll_nsec = -1;
+
+	if (set->ops->aux_ops && set->ops->aux_ops->poll)
+		queue_flag_set_unlocked(QUEUE_FLAG_POLL, q);
+
     //q->softirq_done_fnΪnvme_pci_complete_rq
 	if (set->ops->complete)
 		blk_queue_softirq_done(q, set->ops->complete);
@@ -3396,6 +3716,188 @@ static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb)
 		q->poll_stat[WRITE] = cb->stat[WRITE];
 }
 
+static bool blk_poll_stats_enable(struct request_queue *q)
+{
+	if (test_bit(QUEUE_FLAG_POLL_STATS, &q->queue_flags) ||
+	    test_and_set_bit(QUEUE_FLAG_POLL_STATS, &q->queue_flags))
+		return true;
+	blk_stat_add_callback(q, q->poll_cb);
+	return false;
+}
+
+static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
+				       struct blk_mq_hw_ctx *hctx,
+				       struct request *rq)
+{
+	unsigned long ret = 0;
+	int bucket;
+
+	/*
+	 * If stats collection isn't on, don't sleep but turn it on for
+	 * future users
+	 */
+	if (!blk_poll_stats_enable(q))
+		return 0;
+
+	/*
+	 * As an optimistic guess, use half of the mean service time
+	 * for this type of request. We can (and should) make this smarter.
+	 * For instance, if the completion latencies are tight, we can
+	 * get closer than just half the mean. This is especially
+	 * important on devices where the completion latencies are longer
+	 * than ~10 usec. We do use the stats for the relevant IO size
+	 * if available which does lead to better estimates.
+	 */
+	bucket = blk_stat_rq_ddir(rq);
+	if (q->poll_stat[bucket].nr_samples)
+		ret = (q->poll_stat[bucket].mean + 1) / 2;
+
+	return ret;
+}
+
+static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
+				     struct blk_mq_hw_ctx *hctx,
+				     struct request *rq)
+{
+	struct hrtimer_sleeper hs;
+	enum hrtimer_mode mode;
+	unsigned int nsecs;
+	ktime_t kt;
+
+	if (test_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags))
+		return false;
+
+	/*
+	 * poll_nsec can be:
+	 *
+	 * -1:	don't ever hybrid sleep
+	 *  0:	use half of prev avg
+	 * >0:	use this specific value
+	 */
+	if (q->poll_nsec == -1)
+		return false;
+	else if (q->poll_nsec > 0)
+		nsecs = q->poll_nsec;
+	else
+		nsecs = blk_mq_poll_nsecs(q, hctx, rq);
+
+	if (!nsecs)
+		return false;
+
+	set_bit(REQ_ATOM_POLL_SLEPT, &rq->atomic_flags);
+
+	kt = ktime_set(0, nsecs);
+
+	mode = HRTIMER_MODE_REL;
+	hrtimer_init_on_stack(&hs.timer, CLOCK_MONOTONIC, mode);
+	hrtimer_set_expires(&hs.timer, kt);
+
+	hrtimer_init_sleeper(&hs, current);
+	do {
+		if (test_bit(REQ_ATOM_COMPLETE, &rq->atomic_flags))
+			break;
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		hrtimer_start_expires(&hs.timer, mode);
+		if (hs.task)
+			io_schedule();
+		hrtimer_cancel(&hs.timer);
+		mode = HRTIMER_MODE_ABS;
+	} while (hs.task && !signal_pending(current));
+
+	__set_current_state(TASK_RUNNING);
+	destroy_hrtimer_on_stack(&hs.timer);
+	return true;
+}
+
+static bool __blk_mq_poll(struct blk_mq_hw_ctx *hctx, struct request *rq)
+{
+	struct request_queue *q = hctx->queue;
+	long state;
+
+	/*
+	 * If we sleep, have the caller restart the poll loop to reset
+	 * the state. Like for the other success return cases, the
+	 * caller is responsible for checking if the IO completed. If
+	 * the IO isn't complete, we'll get called again and will go
+	 * straight to the busy poll loop.
+	 */
+	if (blk_mq_poll_hybrid_sleep(q, hctx, rq))
+		return true;
+
+	hctx->poll_considered++;
+
+	state = current->state;
+	while (!need_resched()) {
+		int ret;
+
+		hctx->poll_invoked++;
+
+		ret = q->mq_ops->aux_ops->poll(hctx, rq->tag);
+		if (ret > 0) {
+			hctx->poll_success++;
+			set_current_state(TASK_RUNNING);
+			return true;
+		}
+
+		if (signal_pending_state(state, current))
+			set_current_state(TASK_RUNNING);
+
+		if (current->state == TASK_RUNNING)
+			return true;
+		if (ret < 0)
+			break;
+		cpu_relax();
+	}
+
+	return false;
+}
+
+/**
+ * blk_poll - poll for the completion of a request
+ * @q:		the queue the request was issued to
+ * @cookie:	the bio's bi_cookie, filled in when it was submitted
+ *
+ * Description:
+ *    Spin on the hardware queue the request went to, reaping completions,
+ *    until the request completes, the task needs to reschedule or gets a
+ *    signal.  The caller must hold a reference on the bio and set its task
+ *    state as it would before sleeping for the completion.  Returns %true
+ *    if the caller should recheck for completion without sleeping.
+ */
+bool blk_poll(struct request_queue *q, blk_qc_t cookie)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_plug *plug;
+	struct request *rq;
+
+	if (!q->mq_ops || !q->mq_ops->aux_ops || !q->mq_ops->aux_ops->poll ||
+	    !blk_qc_t_valid(cookie) ||
+	    !test_bit(QUEUE_FLAG_POLL, &q->queue_flags))
+		return false;
+
+	plug = current->plug;
+	if (plug)
+		blk_flush_plug_list(plug, false);
+
+	hctx = q->queue_hw_ctx[blk_qc_t_to_queue_num(cookie)];
+	if (!blk_qc_t_is_internal(cookie))
+		rq = blk_mq_tag_to_rq(hctx->tags, blk_qc_t_to_tag(cookie));
+	else {
+		rq = blk_mq_tag_to_rq(hctx->sched_tags, blk_qc_t_to_tag(cookie));
+		/*
+		 * With scheduling, if the request has completed, we'll
+		 * get a NULL return here, as we clear the sched tag when
+		 * that happens. The request still remains valid, like always,
+		 * so we should be safe with just the NULL check.
+		 */
+		if (!rq)
+			return false;
+	}
+
+	return __blk_mq_poll(hctx, rq);
+}
+EXPORT_SYMBOL_GPL(blk_poll);
+
 void blk_mq_disable_hotplug(void)
 {
 	mutex_lock(&all_q_mutex);
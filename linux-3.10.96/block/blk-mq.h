@@ -2,12 +2,15 @@
 #define INT_BLK_MQ_H
 
 #include <linux/rh_kabi.h>
+#include <linux/hashtable.h>
 
 #include "blk-stat.h"
 #include "blk-mq-tag.h"
 
 struct blk_mq_tag_set;
 
+#define BLK_MQ_CTX_HASH_BITS	4
+
 //УÿCPUһ
 struct blk_mq_ctx {
 	//struct {----ӰĶע͵
@@ -17,6 +20,8 @@ struct blk_mq_ctx {
  //blk_mq_sched_insert_requests->blk_mq_insert_requestsѵǰ̵plugϵreq뵽rq_listϣЩreqò
  //ӲûüreqѵоǽӲʣµѽ
         struct list_head	rq_list;//дreq
+		/* rq_list entries by end sector, see blk_mq_attempt_merge() */
+		DECLARE_HASHTABLE(rq_hash, BLK_MQ_CTX_HASH_BITS);
 	//}  ____cacheline_aligned_in_smp;
 
     //жӦCPUţCPUȥѰӲнṹ壬blk_mq_make_request->blk_mq_sched_bio_merge->__blk_mq_sched_bio_merge->blk_mq_map_queue
@@ -33,6 +38,9 @@ struct blk_mq_ctx {
 	/* incremented at dispatch time */
 	unsigned long		rq_dispatched[2];
 	unsigned long		rq_merged;
+	unsigned long		rq_merge_hash;	/* back merges found by hash */
+	unsigned long		rq_merge_scan;	/* merges found by list scan */
+	unsigned long		rq_merge_miss;
 
 	/* incremented at completion time */
 	unsigned long		____cacheline_aligned_in_smp rq_completed[2];
@@ -47,6 +55,8 @@ int blk_mq_update_nr_requests(struct request_queue *q, unsigned int nr);
 void blk_mq_wake_waiters(struct request_queue *q);
 bool blk_mq_dispatch_rq_list(struct request_queue *, struct list_head *, bool);
 void blk_mq_flush_busy_ctxs(struct blk_mq_hw_ctx *hctx, struct list_head *list);
+bool blk_mq_attempt_merge(struct request_queue *q, struct blk_mq_ctx *ctx,
+			  struct bio *bio);
 bool blk_mq_get_driver_tag(struct request *rq, struct blk_mq_hw_ctx **hctx,
 				bool wait);
 struct request *blk_mq_dequeue_from_ctx(struct blk_mq_hw_ctx *hctx,
@@ -201,6 +211,14 @@ static inline bool blk_mq_get_dispatch_budget(struct blk_mq_hw_ctx *hctx)
 	return true;
 }
 
+static inline void blk_mq_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+
+	if (q->mq_ops->aux_ops && q->mq_ops->aux_ops->commit_rqs)
+		q->mq_ops->aux_ops->commit_rqs(hctx);
+}
+
 static inline void __blk_mq_put_driver_tag(struct blk_mq_hw_ctx *hctx,
 					   struct request *rq)
 {
@@ -82,19 +82,23 @@ static void __blk_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->nr_batch++;
 }
 
-void blk_stat_add(struct request *rq)
+/*
+ * @now is the completion time in ktime nsecs, callers completing a batch
+ * of requests read the clock once for all of them.
+ */
+void blk_stat_add(struct request *rq, u64 now)
 {
 	struct request_queue *q = rq->q;
 	struct blk_stat_callback *cb;
 	struct blk_rq_stat *stat;
 	int bucket;
-	s64 now, value;
+	s64 value;
 
-	now = __blk_stat_time(ktime_to_ns(ktime_get()));
-	if (now < blk_stat_time(&rq_aux(rq)->issue_stat))
+	now = __blk_stat_time(now);
+	if (now < blk_stat_time(rq_issue_stat(rq)))
 		return;
 
-	value = now - blk_stat_time(&rq_aux(rq)->issue_stat);
+	value = now - blk_stat_time(rq_issue_stat(rq));
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
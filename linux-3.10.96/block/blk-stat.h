@@ -3,14 +3,15 @@
 
 #include <linux/kernel.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/ktime.h>
 #include <linux/rcupdate.h>
 #include <linux/timer.h>
 
 /*
- * Upper 3 bits can be used elsewhere
+ * Upper 4 bits can be used elsewhere
  */
-#define BLK_STAT_RES_BITS	3
+#define BLK_STAT_RES_BITS	4
 #define BLK_STAT_SHIFT		(64 - BLK_STAT_RES_BITS)
 #define BLK_STAT_TIME_MASK	((1ULL << BLK_STAT_SHIFT) - 1)
 #define BLK_STAT_MASK		~BLK_STAT_TIME_MASK
@@ -72,7 +73,18 @@ struct blk_stat_callback {
 struct blk_queue_stats *blk_alloc_queue_stats(void);
 void blk_free_queue_stats(struct blk_queue_stats *);
 
-void blk_stat_add(struct request *);
+void blk_stat_add(struct request *, u64 now);
+
+/*
+ * blk-mq requests carry their issue stat in the request_aux, legacy
+ * requests in struct request itself.
+ */
+static inline struct blk_issue_stat *rq_issue_stat(struct request *rq)
+{
+	if (rq->q->mq_ops)
+		return &rq_aux(rq)->issue_stat;
+	return &rq->issue_stat;
+}
 
 static inline void blk_stat_set_issue_time(struct blk_issue_stat *stat)
 {
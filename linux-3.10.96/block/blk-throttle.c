@@ -21,6 +21,9 @@ static int throtl_quantum = 32;
 /* Throttling is performed over 100ms slice and after that slice is renewed */
 static unsigned long throtl_slice = HZ/10;	/* 100 ms */
 
+/* A cpu is handed 1/8th of the per slice limit as lockless budget at once */
+#define THROTL_BUDGET_SHIFT	3
+
 static struct blkcg_policy blkcg_policy_throtl;
 
 /* A workqueue to queue throttle related work */
@@ -40,12 +43,27 @@ struct throtl_rb_root {
 
 #define rb_entry_tg(node)	rb_entry((node), struct throtl_grp, rb_node)
 
-/* Per-cpu group stats */
+/*
+ * Dispatch budget a cpu was handed for one direction.  It has been charged
+ * to the group already, so bios fitting in it can be dispatched without
+ * the queue lock.  Only valid while ->gen matches the group's and until
+ * ->expires.
+ */
+struct tg_budget {
+	u64				bytes;
+	unsigned int			ios;
+	unsigned int			gen;
+	unsigned long			expires;
+};
+
+/* Per-cpu group stats and dispatch budget */
 struct tg_stats_cpu {
 	/* total bytes transferred */
 	struct blkg_rwstat		service_bytes;
 	/* total IOs serviced, post merge */
 	struct blkg_rwstat		serviced;
+	/* lockless dispatch budget for READ and WRITE */
+	struct tg_budget		budget[2];
 };
 //blkio iopsƽṹ
 struct throtl_grp {
@@ -88,6 +106,9 @@ struct throtl_grp {
 	/* Some throttle limits got updated for the group */
 	int limits_changed;
 
+	/* bumped to invalidate all per cpu budgets of a direction */
+	unsigned int budget_gen[2];
+
 	/* Per cpu stats pointer */
 	struct tg_stats_cpu __percpu *stats_cpu;
 
@@ -429,6 +450,7 @@ throtl_start_new_slice(struct throtl_data *td, struct throtl_grp *tg, bool rw)
 {
 	tg->bytes_disp[rw] = 0;
 	tg->io_disp[rw] = 0;
+	tg->budget_gen[rw]++;
 	tg->slice_start[rw] = jiffies;
 	tg->slice_end[rw] = jiffies + throtl_slice;
 	throtl_log_tg(td, tg, "[%c] new slice start=%lu end=%lu jiffies=%lu",
@@ -711,6 +733,139 @@ static void throtl_charge_bio(struct throtl_grp *tg, struct bio *bio)
 	throtl_update_dispatch_stats(tg_to_blkg(tg), bio->bi_size, bio->bi_rw);
 }
 
+/* Length of the current slice of @tg, rounded up to whole slices */
+static unsigned long tg_slice_elapsed_rnd(struct throtl_grp *tg, bool rw)
+{
+	unsigned long jiffy_elapsed_rnd = jiffies - tg->slice_start[rw];
+
+	/* Slice has just started. Consider one slice interval */
+	if (!jiffy_elapsed_rnd)
+		jiffy_elapsed_rnd = throtl_slice;
+
+	return roundup(jiffy_elapsed_rnd, throtl_slice);
+}
+
+/* Bytes @tg may still dispatch in the current slice */
+static u64 tg_bps_headroom(struct throtl_grp *tg, bool rw)
+{
+	u64 allowed = tg->bps[rw] * tg_slice_elapsed_rnd(tg, rw);
+
+	do_div(allowed, HZ);
+	if (allowed <= tg->bytes_disp[rw])
+		return 0;
+	return allowed - tg->bytes_disp[rw];
+}
+
+/* Number of bios @tg may still dispatch in the current slice */
+static unsigned int tg_iops_headroom(struct throtl_grp *tg, bool rw)
+{
+	u64 allowed = (u64)tg->iops[rw] * tg_slice_elapsed_rnd(tg, rw);
+
+	do_div(allowed, HZ);
+	if (allowed <= tg->io_disp[rw])
+		return 0;
+	return min_t(u64, allowed - tg->io_disp[rw], UINT_MAX);
+}
+
+/*
+ * Give the unused part of this cpu's budget back to the group.  Should be
+ * called with queue lock held.
+ */
+static void throtl_return_budget(struct throtl_grp *tg, bool rw)
+{
+	struct tg_budget *bgt;
+
+	if (tg->stats_cpu == NULL)
+		return;
+
+	bgt = &this_cpu_ptr(tg->stats_cpu)->budget[rw];
+	if (bgt->gen == tg->budget_gen[rw]) {
+		if (tg->bps[rw] != -1)
+			tg->bytes_disp[rw] -= min(bgt->bytes, tg->bytes_disp[rw]);
+		if (tg->iops[rw] != -1)
+			tg->io_disp[rw] -= min(bgt->ios, tg->io_disp[rw]);
+	}
+	bgt->bytes = 0;
+	bgt->ios = 0;
+}
+
+/*
+ * Charge a slice of the group's remaining headroom up front and hand it to
+ * this cpu, so that the next bios it submits to @tg can be dispatched by
+ * throtl_charge_bio_budget() without taking the queue lock.  Should be
+ * called with queue lock held, after the bio that brought us here has
+ * been charged.
+ */
+static void throtl_grant_budget(struct throtl_grp *tg, bool rw)
+{
+	struct tg_budget *bgt;
+	u64 bytes = -1, quantum;
+	unsigned int ios = -1;
+
+	if (tg->stats_cpu == NULL)
+		return;
+
+	if (tg->bps[rw] != -1) {
+		quantum = tg->bps[rw] * throtl_slice;
+		do_div(quantum, HZ << THROTL_BUDGET_SHIFT);
+		bytes = min(tg_bps_headroom(tg, rw), quantum);
+	}
+	if (tg->iops[rw] != -1) {
+		quantum = (u64)tg->iops[rw] * throtl_slice;
+		do_div(quantum, HZ << THROTL_BUDGET_SHIFT);
+		ios = min_t(u64, tg_iops_headroom(tg, rw), quantum);
+	}
+	if (!bytes || !ios)
+		return;
+
+	if (tg->bps[rw] != -1)
+		tg->bytes_disp[rw] += bytes;
+	if (tg->iops[rw] != -1)
+		tg->io_disp[rw] += ios;
+
+	bgt = &this_cpu_ptr(tg->stats_cpu)->budget[rw];
+	bgt->bytes = bytes;
+	bgt->ios = ios;
+	bgt->gen = tg->budget_gen[rw];
+	bgt->expires = tg->slice_end[rw];
+}
+
+/*
+ * Lockless fast path: dispatch @bio out of this cpu's budget for @tg.
+ * Returns false if the budget doesn't cover @bio, or if other bios are
+ * already waiting in the same direction and @bio mustn't overtake them.
+ */
+static bool throtl_charge_bio_budget(struct throtl_grp *tg, struct bio *bio)
+{
+	bool rw = bio_data_dir(bio);
+	struct tg_stats_cpu *stats_cpu;
+	struct tg_budget *bgt;
+	unsigned long flags;
+	bool ret = false;
+
+	if (tg->stats_cpu == NULL || ACCESS_ONCE(tg->nr_queued[rw]))
+		return false;
+
+	/* see throtl_update_dispatch_stats() */
+	local_irq_save(flags);
+
+	stats_cpu = this_cpu_ptr(tg->stats_cpu);
+	bgt = &stats_cpu->budget[rw];
+	if (bgt->gen == ACCESS_ONCE(tg->budget_gen[rw]) &&
+	    time_before(jiffies, bgt->expires) &&
+	    bgt->bytes >= bio->bi_size && bgt->ios) {
+		bgt->bytes -= bio->bi_size;
+		bgt->ios--;
+		blkg_rwstat_add(&stats_cpu->serviced, bio->bi_rw, 1);
+		blkg_rwstat_add(&stats_cpu->service_bytes, bio->bi_rw,
+				bio->bi_size);
+		ret = true;
+	}
+
+	local_irq_restore(flags);
+	return ret;
+}
+
 static void throtl_add_bio_tg(struct throtl_data *td, struct throtl_grp *tg,
 			struct bio *bio)
 {
@@ -1025,6 +1180,10 @@ static int tg_set_conf(struct cgroup *cgrp, struct cftype *cft, const char *buf,
 	if (!ctx.v)
 		ctx.v = -1;
 
+	/* budgets handed out under the old limits are void */
+	tg->budget_gen[READ]++;
+	tg->budget_gen[WRITE]++;
+
     //ctx->vҪõֵecho "233:1 10240" > blkio.throttle.write_bps_device 10240
     //cft->privateblkioÿcgroupļthrotl_grpṹƫƣstruct cftype throtl_files[]
 	if (is_u64)
@@ -1141,6 +1300,10 @@ bool blk_throtl_bio(struct request_queue *q, struct bio *bio)
 						     bio->bi_size, bio->bi_rw);
 			goto out_unlock_rcu;
 		}
+
+		/* Bio fits in what this cpu was handed earlier */
+		if (throtl_charge_bio_budget(tg, bio))
+			goto out_unlock_rcu;
 	}
 
 	/*
@@ -1152,6 +1315,12 @@ bool blk_throtl_bio(struct request_queue *q, struct bio *bio)
 	if (unlikely(!tg))
 		goto out_unlock;
 
+	/*
+	 * Whatever is left of this cpu's budget didn't cover the bio, hand
+	 * it back so that it is accounted against the limit again.
+	 */
+	throtl_return_budget(tg, rw);
+
 	if (tg->nr_queued[rw]) {
 		/*
 		 * There is already another bio queued in same dir. No
@@ -1179,6 +1348,7 @@ bool blk_throtl_bio(struct request_queue *q, struct bio *bio)
 		 * So keep on trimming slice even if bio is not queued.
 		 */
 		throtl_trim_slice(td, tg, rw);
+		throtl_grant_budget(tg, rw);
 		goto out_unlock;
 	}
 
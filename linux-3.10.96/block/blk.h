@@ -42,6 +42,8 @@ void blk_add_timer(struct request *);
  */
 enum rq_atomic_flags {
 	REQ_ATOM_COMPLETE = 0,
+	REQ_ATOM_STARTED,
+	REQ_ATOM_POLL_SLEPT,
 };
 
 /*
@@ -63,6 +65,11 @@ static inline void blk_clear_rq_complete(struct request *rq)
  */
 #define ELV_ON_HASH(rq) hash_hashed(&(rq)->hash)
 
+/*
+ * Merge hash stuff, keyed on the end sector for back merges
+ */
+#define rq_hash_key(rq)		(blk_rq_pos(rq) + blk_rq_sectors(rq))
+
 void blk_insert_flush(struct request *rq);
 void blk_abort_flushes(struct request_queue *q);
 
@@ -215,6 +222,38 @@ static inline struct io_context *create_io_context(gfp_t gfp_mask, int node)
 	return current->io_context;
 }
 
+/*
+ * Inflight accounting shared by the depth based throttlers, blk-wbt and
+ * blk-iolatency. Submitters sleep on @wait until @inflight drops below
+ * their limit.
+ */
+struct rq_wait {
+	wait_queue_head_t wait;
+	atomic_t inflight;
+};
+
+/*
+ * Increment @rqw->inflight if it is below @limit. Returns true if we
+ * succeeded, false if the increment would take it to or past @limit.
+ */
+static inline bool rq_wait_inc_below(struct rq_wait *rqw, unsigned int limit)
+{
+	unsigned int cur = atomic_read(&rqw->inflight);
+
+	for (;;) {
+		unsigned int old;
+
+		if (cur >= limit)
+			return false;
+		old = atomic_cmpxchg(&rqw->inflight, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
 /*
  * Internal throttling interface
  */
@@ -233,4 +272,33 @@ static inline int blk_throtl_init(struct request_queue *q) { return 0; }
 static inline void blk_throtl_exit(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * Per-cgroup latency protection, see blk-iolatency.c
+ */
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+extern struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+					       struct bio *bio,
+					       spinlock_t *lock);
+extern void blk_iolatency_track(struct request *rq, struct blkcg_gq *blkg);
+extern void blk_iolatency_cancel(struct request_queue *q,
+				 struct blkcg_gq *blkg);
+extern void blk_iolatency_done(struct request *rq);
+extern int blk_iolatency_init(struct request_queue *q);
+extern void blk_iolatency_exit(struct request_queue *q);
+#else /* CONFIG_BLK_CGROUP_IOLATENCY */
+static inline struct blkcg_gq *blk_iolatency_throttle(struct request_queue *q,
+						      struct bio *bio,
+						      spinlock_t *lock)
+{
+	return NULL;
+}
+static inline void blk_iolatency_track(struct request *rq,
+				       struct blkcg_gq *blkg) { }
+static inline void blk_iolatency_cancel(struct request_queue *q,
+					struct blkcg_gq *blkg) { }
+static inline void blk_iolatency_done(struct request *rq) { }
+static inline int blk_iolatency_init(struct request_queue *q) { return 0; }
+static inline void blk_iolatency_exit(struct request_queue *q) { }
+#endif /* CONFIG_BLK_CGROUP_IOLATENCY */
+
 #endif /* BLK_INTERNAL_H */
@@ -16,6 +16,7 @@
 #include <linux/blktrace_api.h>
 #include "blk.h"
 #include "blk-cgroup.h"
+#include "blk-wbt.h"
 
 /*
  * tunables
@@ -4454,6 +4455,7 @@ static int cfq_init_queue(struct request_queue *q, struct elevator_type *e)
 	 * second, in order to have larger depth for async operations.
 	 */
 	cfqd->last_delayed_sync = jiffies - HZ;
+	wbt_disable_default(q);
 	return 0;
 
 out_free:
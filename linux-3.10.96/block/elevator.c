@@ -40,16 +40,11 @@
 
 #include "blk.h"
 #include "blk-cgroup.h"
+#include "blk-wbt.h"
 
 static DEFINE_SPINLOCK(elv_list_lock);
 static LIST_HEAD(elv_list);
 
-/*
- * Merge hash stuff.
- */
-//hash keyreqַѽ
-#define rq_hash_key(rq)		(blk_rq_pos(rq) + blk_rq_sectors(rq))
-
 /*
  * Query io scheduler to see if the current process issuing bio may be
  * merged with rq.
@@ -1046,6 +1041,10 @@ static int elevator_switch(struct request_queue *q, struct elevator_type *new_e)
 	elevator_exit(old);
 	blk_queue_bypass_end(q);
 
+	/* leaving CFQ: throttle writeback again, if that's the default */
+	if (registered)
+		wbt_enable_default(q);
+
 	blk_add_trace_msg(q, "elv switch: %s", new_e->elevator_name);
 
 	return 0;
@@ -1057,6 +1056,8 @@ fail_init:
 	q->elevator = old;
 	elv_register_queue(q);
 	blk_queue_bypass_end(q);
+	if (registered)
+		wbt_enable_default(q);
 
 	return err;
 }
@@ -0,0 +1,495 @@
+/*
+ * Null block device driver
+ *
+ * A blk-mq driver that completes requests without touching any hardware,
+ * so that the cost of the block layer itself (submission, tagging, I/O
+ * scheduling and completion) can be measured in isolation.  Completions
+ * can be issued inline, through the softirq path or after a fixed delay
+ * from an hrtimer, and the device may optionally keep the data written to
+ * it in memory.
+ */
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/blk-mq.h>
+#include <linux/hrtimer.h>
+#include <linux/highmem.h>
+#include <linux/log2.h>
+#include <linux/radix-tree.h>
+
+#define SECTOR_SHIFT		9
+#define PAGE_SECTORS_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
+#define PAGE_SECTORS		(1 << PAGE_SECTORS_SHIFT)
+
+struct nullb_cmd {
+	struct request *rq;
+	struct hrtimer timer;
+	int error;
+};
+
+struct nullb {
+	struct list_head list;
+	unsigned int index;
+	struct request_queue *q;
+	struct gendisk *disk;
+	struct blk_mq_tag_set *tag_set;
+	struct blk_mq_tag_set __tag_set;
+
+	/* backing pages indexed by page offset, only with memory_backed */
+	spinlock_t lock;
+	struct radix_tree_root pages;
+
+	char disk_name[DISK_NAME_LEN];
+};
+
+static LIST_HEAD(nullb_list);
+static DEFINE_MUTEX(lock);
+static int null_major;
+static int nullb_indexes;
+static struct blk_mq_tag_set tag_set;
+
+enum {
+	NULL_IRQ_NONE		= 0,
+	NULL_IRQ_SOFTIRQ	= 1,
+	NULL_IRQ_TIMER		= 2,
+};
+
+static int submit_queues;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Number of hardware queues, default is one per online CPU");
+
+static int home_node = NUMA_NO_NODE;
+module_param(home_node, int, S_IRUGO);
+MODULE_PARM_DESC(home_node, "Home node for the device");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size (in bytes)");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int irqmode = NULL_IRQ_SOFTIRQ;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "IRQ completion handler. 0-none, 1-softirq, 2-timer");
+
+static unsigned long completion_nsec = 10000;
+module_param(completion_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
+
+static bool shared_tags;
+module_param(shared_tags, bool, S_IRUGO);
+MODULE_PARM_DESC(shared_tags, "Share tag set between devices. Default: false");
+
+static bool memory_backed;
+module_param(memory_backed, bool, S_IRUGO);
+MODULE_PARM_DESC(memory_backed, "Store written data in memory. Default: false");
+
+static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
+{
+	struct nullb_cmd *cmd = container_of(timer, struct nullb_cmd, timer);
+
+	blk_mq_end_request(cmd->rq, cmd->error);
+	return HRTIMER_NORESTART;
+}
+
+static void null_softirq_done_fn(struct request *rq)
+{
+	blk_mq_end_request(rq, rq->errors);
+}
+
+static void null_complete_cmd(struct nullb_cmd *cmd)
+{
+	switch (irqmode) {
+	case NULL_IRQ_SOFTIRQ:
+		blk_mq_complete_request(cmd->rq, cmd->error);
+		break;
+	case NULL_IRQ_TIMER:
+		hrtimer_start(&cmd->timer, ktime_set(0, completion_nsec),
+			      HRTIMER_MODE_REL);
+		break;
+	case NULL_IRQ_NONE:
+	default:
+		blk_mq_end_request(cmd->rq, cmd->error);
+		break;
+	}
+}
+
+/*
+ * The backing store is only touched from ->queue_rq(), which may run in
+ * atomic context, so pages are allocated with GFP_ATOMIC and the copy is
+ * done under nullb->lock to keep a concurrent discard from freeing the
+ * page underneath it.
+ */
+static struct page *null_lookup_page(struct nullb *nullb, sector_t sector)
+{
+	return radix_tree_lookup(&nullb->pages, sector >> PAGE_SECTORS_SHIFT);
+}
+
+static struct page *null_insert_page(struct nullb *nullb, sector_t sector)
+{
+	pgoff_t idx = sector >> PAGE_SECTORS_SHIFT;
+	struct page *page;
+
+	page = radix_tree_lookup(&nullb->pages, idx);
+	if (page)
+		return page;
+
+	page = alloc_page(GFP_ATOMIC | __GFP_ZERO);
+	if (!page)
+		return NULL;
+
+	page->index = idx;
+	if (radix_tree_insert(&nullb->pages, idx, page)) {
+		__free_page(page);
+		return NULL;
+	}
+	return page;
+}
+
+static void null_free_pages(struct nullb *nullb)
+{
+	struct page *pages[16];
+	pgoff_t pos = 0;
+	int nr, i;
+
+	do {
+		nr = radix_tree_gang_lookup(&nullb->pages, (void **)pages, pos,
+					    ARRAY_SIZE(pages));
+		for (i = 0; i < nr; i++) {
+			pos = pages[i]->index;
+			radix_tree_delete(&nullb->pages, pos);
+			__free_page(pages[i]);
+		}
+		pos++;
+	} while (nr == ARRAY_SIZE(pages));
+}
+
+static int null_copy(struct nullb *nullb, void *buf, sector_t sector,
+		     unsigned int len, int rw)
+{
+	while (len) {
+		unsigned int offset = (sector & (PAGE_SECTORS - 1)) << SECTOR_SHIFT;
+		unsigned int chunk = min_t(unsigned int, len, PAGE_SIZE - offset);
+		struct page *page;
+		void *mem;
+
+		if (rw == WRITE) {
+			page = null_insert_page(nullb, sector);
+			if (!page)
+				return -ENOMEM;
+			mem = kmap_atomic(page);
+			memcpy(mem + offset, buf, chunk);
+			kunmap_atomic(mem);
+		} else {
+			page = null_lookup_page(nullb, sector);
+			if (page) {
+				mem = kmap_atomic(page);
+				memcpy(buf, mem + offset, chunk);
+				kunmap_atomic(mem);
+			} else {
+				memset(buf, 0, chunk);
+			}
+		}
+
+		buf += chunk;
+		sector += chunk >> SECTOR_SHIFT;
+		len -= chunk;
+	}
+	return 0;
+}
+
+static void null_discard(struct nullb *nullb, sector_t sector,
+			 unsigned int nr_sects)
+{
+	struct page *page;
+
+	/* only whole pages are dropped, partial ones keep stale data */
+	if (sector & (PAGE_SECTORS - 1)) {
+		unsigned int skip = PAGE_SECTORS - (sector & (PAGE_SECTORS - 1));
+
+		if (nr_sects <= skip)
+			return;
+		sector += skip;
+		nr_sects -= skip;
+	}
+
+	while (nr_sects >= PAGE_SECTORS) {
+		page = radix_tree_delete(&nullb->pages,
+					 sector >> PAGE_SECTORS_SHIFT);
+		if (page)
+			__free_page(page);
+		sector += PAGE_SECTORS;
+		nr_sects -= PAGE_SECTORS;
+	}
+}
+
+static int null_handle_rq(struct nullb *nullb, struct request *rq)
+{
+	sector_t sector = blk_rq_pos(rq);
+	struct req_iterator iter;
+	struct bio_vec *bvec;
+	int rw = rq_data_dir(rq);
+	int err = 0;
+
+	if (rq->cmd_type != REQ_TYPE_FS || (rq->cmd_flags & REQ_FLUSH))
+		return 0;
+
+	spin_lock(&nullb->lock);
+	if (rq->cmd_flags & REQ_DISCARD) {
+		null_discard(nullb, sector, blk_rq_sectors(rq));
+		goto out;
+	}
+
+	rq_for_each_segment(bvec, rq, iter) {
+		void *mem = kmap_atomic(bvec->bv_page);
+
+		err = null_copy(nullb, mem + bvec->bv_offset, sector,
+				bvec->bv_len, rw);
+		kunmap_atomic(mem);
+		if (err)
+			break;
+		sector += bvec->bv_len >> SECTOR_SHIFT;
+	}
+out:
+	spin_unlock(&nullb->lock);
+	return err;
+}
+
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx,
+			 const struct blk_mq_queue_data *bd)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(bd->rq);
+	struct nullb *nullb = hctx->queue->queuedata;
+
+	blk_mq_start_request(bd->rq);
+
+	cmd->error = 0;
+	if (memory_backed)
+		cmd->error = null_handle_rq(nullb, bd->rq);
+
+	null_complete_cmd(cmd);
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int null_init_request(struct blk_mq_tag_set *set, struct request *rq,
+			     unsigned int hctx_idx, unsigned int numa_node)
+{
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+	cmd->rq = rq;
+	hrtimer_init(&cmd->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cmd->timer.function = null_cmd_timer_expired;
+	return 0;
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+	.complete	= null_softirq_done_fn,
+	.init_request	= null_init_request,
+};
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static int null_init_tag_set(struct blk_mq_tag_set *set)
+{
+	set->ops = &null_mq_ops;
+	set->nr_hw_queues = submit_queues;
+	set->queue_depth = hw_queue_depth;
+	set->numa_node = home_node;
+	set->cmd_size = sizeof(struct nullb_cmd);
+	set->flags = BLK_MQ_F_SHOULD_MERGE;
+	set->driver_data = NULL;
+
+	return blk_mq_alloc_tag_set(set);
+}
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del_init(&nullb->list);
+
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	if (nullb->tag_set == &nullb->__tag_set)
+		blk_mq_free_tag_set(nullb->tag_set);
+	put_disk(nullb->disk);
+	null_free_pages(nullb);
+	kfree(nullb);
+}
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	sector_t size;
+	int rv;
+
+	nullb = kzalloc_node(sizeof(*nullb), GFP_KERNEL, home_node);
+	if (!nullb) {
+		rv = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock_init(&nullb->lock);
+	INIT_RADIX_TREE(&nullb->pages, GFP_ATOMIC);
+
+	if (shared_tags) {
+		nullb->tag_set = &tag_set;
+	} else {
+		nullb->tag_set = &nullb->__tag_set;
+		rv = null_init_tag_set(nullb->tag_set);
+		if (rv)
+			goto out_free_nullb;
+	}
+
+	nullb->q = blk_mq_init_queue(nullb->tag_set);
+	if (IS_ERR(nullb->q)) {
+		rv = -ENOMEM;
+		goto out_cleanup_tags;
+	}
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, nullb->q);
+
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	if (memory_backed) {
+		nullb->q->limits.discard_granularity = bs;
+		nullb->q->limits.discard_alignment = bs;
+		blk_queue_max_discard_sectors(nullb->q, UINT_MAX >> 9);
+		queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, nullb->q);
+	}
+
+	disk = nullb->disk = alloc_disk_node(1, home_node);
+	if (!disk) {
+		rv = -ENOMEM;
+		goto out_cleanup_blk_queue;
+	}
+
+	mutex_lock(&lock);
+	list_add_tail(&nullb->list, &nullb_list);
+	nullb->index = nullb_indexes++;
+	mutex_unlock(&lock);
+
+	size = gb * 1024 * 1024 * 1024ULL;
+	set_capacity(disk, size >> 9);
+
+	disk->flags |= GENHD_FL_EXT_DEVT | GENHD_FL_SUPPRESS_PARTITION_INFO;
+	disk->major		= null_major;
+	disk->first_minor	= nullb->index;
+	disk->fops		= &null_fops;
+	disk->private_data	= nullb;
+	disk->queue		= nullb->q;
+	sprintf(nullb->disk_name, "nullb%d", nullb->index);
+	strncpy(disk->disk_name, nullb->disk_name, DISK_NAME_LEN);
+
+	add_disk(disk);
+	return 0;
+
+out_cleanup_blk_queue:
+	blk_cleanup_queue(nullb->q);
+out_cleanup_tags:
+	if (nullb->tag_set == &nullb->__tag_set)
+		blk_mq_free_tag_set(nullb->tag_set);
+out_free_nullb:
+	kfree(nullb);
+out:
+	return rv;
+}
+
+static int __init null_init(void)
+{
+	int ret = 0;
+	unsigned int i;
+	struct nullb *nullb;
+
+	if (bs > PAGE_SIZE || bs < 512 || !is_power_of_2(bs)) {
+		pr_warn("null_blk: invalid block size\n");
+		pr_warn("null_blk: defaults block size to 512\n");
+		bs = 512;
+	}
+
+	if (irqmode < NULL_IRQ_NONE || irqmode > NULL_IRQ_TIMER) {
+		pr_warn("null_blk: invalid irqmode %d, using softirq\n",
+			irqmode);
+		irqmode = NULL_IRQ_SOFTIRQ;
+	}
+
+	if (submit_queues <= 0 || submit_queues > nr_cpu_ids)
+		submit_queues = num_online_cpus();
+
+	if (hw_queue_depth < 1 || hw_queue_depth > BLK_MQ_MAX_DEPTH) {
+		pr_warn("null_blk: invalid hw_queue_depth %d, using 64\n",
+			hw_queue_depth);
+		hw_queue_depth = 64;
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	if (shared_tags) {
+		ret = null_init_tag_set(&tag_set);
+		if (ret)
+			goto err_reg;
+	}
+
+	for (i = 0; i < nr_devices; i++) {
+		ret = null_add_dev();
+		if (ret)
+			goto err_dev;
+	}
+
+	pr_info("null_blk: module loaded\n");
+	return 0;
+
+err_dev:
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	if (shared_tags)
+		blk_mq_free_tag_set(&tag_set);
+err_reg:
+	unregister_blkdev(null_major, "nullb");
+	return ret;
+}
+
+static void __exit null_exit(void)
+{
+	struct nullb *nullb;
+
+	unregister_blkdev(null_major, "nullb");
+
+	mutex_lock(&lock);
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	mutex_unlock(&lock);
+
+	if (shared_tags)
+		blk_mq_free_tag_set(&tag_set);
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_LICENSE("GPL");
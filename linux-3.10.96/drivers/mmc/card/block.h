@@ -0,0 +1,11 @@
+#ifndef _MMC_CARD_BLOCK_H
+#define _MMC_CARD_BLOCK_H
+
+struct mmc_queue;
+struct request;
+
+int mmc_blk_cqe_issue_rq(struct mmc_queue *mq, struct request *req);
+void mmc_blk_cqe_complete_rq(struct mmc_queue *mq, struct request *req);
+void mmc_blk_cqe_recovery(struct mmc_queue *mq);
+
+#endif
@@ -19,16 +19,19 @@
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
 #include "queue.h"
+#include "block.h"
 
 #define MMC_QUEUE_BOUNCESZ	65536
 
 /*
- * Prepare a MMC request. This just filters out odd stuff.
+ * Tags handed out by the blk-mq path.  Only two requests are ever owned by
+ * the driver (one in flight, one being prepared), the rest is left for
+ * the I/O scheduler to merge and sort.
  */
-static int mmc_prep_request(struct request_queue *q, struct request *req)
-{
-	struct mmc_queue *mq = q->queuedata;
+#define MMC_QUEUE_DEPTH		64
 
+static int mmc_prep_check(struct mmc_queue *mq, struct request *req)
+{
 	/*
 	 * We only like normal block requests and discards.
 	 */
@@ -40,11 +43,80 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	if (mq && (mmc_card_removed(mq->card) || mmc_access_rpmb(mq)))
 		return BLKPREP_KILL;
 
-	req->cmd_flags |= REQ_DONTPREP;
-
 	return BLKPREP_OK;
 }
 
+/*
+ * Prepare a MMC request. This just filters out odd stuff.
+ */
+static int mmc_prep_request(struct request_queue *q, struct request *req)
+{
+	int ret = mmc_prep_check(q->queuedata, req);
+
+	if (ret == BLKPREP_OK)
+		req->cmd_flags |= REQ_DONTPREP;
+
+	return ret;
+}
+
+/*
+ * Issue mq->mqrq_cur->req (NULL to only complete the request in flight)
+ * while the previous request, if any, completes, then make the current
+ * request the previous one.  If waiting for the previous request was cut
+ * short by a new request arriving, the slots are left as they are and the
+ * caller has to issue the new request next.
+ */
+static void mmc_queue_issue(struct mmc_queue *mq, struct request *req)
+{
+	unsigned int cmd_flags = req ? req->cmd_flags : 0;
+	struct mmc_queue_req *tmp;
+
+	/* allow nested host claims from this task while issuing */
+	mq->ctx.task = current;
+	mq->issue_fn(mq, req);	/* mmc_blk_issue_rq() */
+	mq->ctx.task = NULL;
+
+	if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
+		mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
+		return;
+	}
+
+	/*
+	 * Current request becomes previous request
+	 * and vice versa.
+	 * In case of special requests, current request
+	 * has been finished. Do not assign it to previous
+	 * request.
+	 */
+	if (cmd_flags & MMC_REQ_SPECIAL_MASK)
+		mq->mqrq_cur->req = NULL;
+
+	mq->mqrq_prev->brq.mrq.data = NULL;
+	mq->mqrq_prev->req = NULL;
+	tmp = mq->mqrq_prev;
+	mq->mqrq_prev = mq->mqrq_cur;
+	mq->mqrq_cur = tmp;
+}
+
+/*
+ * A new request arrived while the issuer may be blocked waiting for the
+ * previous request to complete with no current request fetched: have it
+ * return so that the new request can be prepared while the previous one
+ * is still in flight.
+ */
+static void mmc_queue_kick_waiter(struct mmc_queue *mq)
+{
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cntx->lock, flags);
+	if (cntx->is_waiting_last_req) {
+		cntx->is_new_req = true;
+		wake_up_interruptible(&cntx->wait);
+	}
+	spin_unlock_irqrestore(&cntx->lock, flags);
+}
+
 static int mmc_queue_thread(void *d)
 {
 	struct mmc_queue *mq = d;
@@ -55,8 +127,6 @@ static int mmc_queue_thread(void *d)
 	down(&mq->thread_sem);
 	do {
 		struct request *req = NULL;
-		struct mmc_queue_req *tmp;
-		unsigned int cmd_flags = 0;
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
@@ -67,28 +137,7 @@ static int mmc_queue_thread(void *d)
 
 		if (req || mq->mqrq_prev->req) {
 			set_current_state(TASK_RUNNING);
-			cmd_flags = req ? req->cmd_flags : 0;
-			mq->issue_fn(mq, req);//mmc_blk_issue_rq() mmcд
-			if (mq->flags & MMC_QUEUE_NEW_REQUEST) {
-				mq->flags &= ~MMC_QUEUE_NEW_REQUEST;
-				continue; /* fetch again */
-			}
-
-			/*
-			 * Current request becomes previous request
-			 * and vice versa.
-			 * In case of special requests, current request
-			 * has been finished. Do not assign it to previous
-			 * request.
-			 */
-			if (cmd_flags & MMC_REQ_SPECIAL_MASK)
-				mq->mqrq_cur->req = NULL;
-
-			mq->mqrq_prev->brq.mrq.data = NULL;
-			mq->mqrq_prev->req = NULL;
-			tmp = mq->mqrq_prev;
-			mq->mqrq_prev = mq->mqrq_cur;
-			mq->mqrq_cur = tmp;
+			mmc_queue_issue(mq, req);
 		} else {
 			if (kthread_should_stop()) {
 				set_current_state(TASK_RUNNING);
@@ -115,8 +164,6 @@ static void mmc_request_fn(struct request_queue *q)
 {
 	struct mmc_queue *mq = q->queuedata;
 	struct request *req;
-	unsigned long flags;
-	struct mmc_context_info *cntx;
 
 	if (!mq) {
 		while ((req = blk_fetch_request(q)) != NULL) {
@@ -126,23 +173,94 @@ static void mmc_request_fn(struct request_queue *q)
 		return;
 	}
 
-	cntx = &mq->card->host->context_info;
-	if (!mq->mqrq_cur->req && mq->mqrq_prev->req) {
-		/*
-		 * New MMC request arrived when MMC thread may be
-		 * blocked on the previous request to be complete
-		 * with no current request fetched
-		 */
-		spin_lock_irqsave(&cntx->lock, flags);
-		if (cntx->is_waiting_last_req) {
-			cntx->is_new_req = true;
-			wake_up_interruptible(&cntx->wait);
-		}
-		spin_unlock_irqrestore(&cntx->lock, flags);
-	} else if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
+	if (!mq->mqrq_cur->req && mq->mqrq_prev->req)
+		mmc_queue_kick_waiter(mq);
+	else if (!mq->mqrq_cur->req && !mq->mqrq_prev->req)
 		wake_up_process(mq->thread);//mmcдں̣̺߳߳mmc_queue_thread()
 }
 
+/* Have complete_work finish the request left in flight, if any */
+static void mmc_mq_flush_inflight(struct mmc_queue *mq)
+{
+	mutex_lock(&mq->issue_mutex);
+	if (mq->mqrq_prev->req)
+		kblockd_schedule_work(mq->queue, &mq->complete_work);
+	mutex_unlock(&mq->issue_mutex);
+}
+
+/*
+ * blk-mq request handler.  The request is issued right here in the
+ * submitting context, serialised against other submitters by issue_mutex,
+ * and is left in flight on return.  It is completed by the next request
+ * issued, which overlaps its preparation with the transfer, or by
+ * complete_work when nothing else arrives.
+ */
+static int mmc_mq_queue_rq(struct blk_mq_hw_ctx *hctx,
+			   const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct mmc_queue *mq = req->q->queuedata;
+
+	if (!mq)
+		goto fail;
+
+	if (mmc_prep_check(mq, req) != BLKPREP_OK) {
+		/* the batch may end here: don't strand the one in flight */
+		mmc_mq_flush_inflight(mq);
+		goto fail;
+	}
+
+	blk_mq_start_request(req);
+
+	if (mq->mqrq_prev->req)
+		mmc_queue_kick_waiter(mq);
+
+	mutex_lock(&mq->issue_mutex);
+	mq->mqrq_cur->req = req;
+	mmc_queue_issue(mq, req);
+	if (bd->last && mq->mqrq_prev->req)
+		kblockd_schedule_work(req->q, &mq->complete_work);
+	mutex_unlock(&mq->issue_mutex);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+
+fail:
+	req->cmd_flags |= REQ_QUIET;
+	return BLK_MQ_RQ_QUEUE_ERROR;
+}
+
+/* Dispatch stopped early: complete what the last request left in flight */
+static void mmc_mq_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct mmc_queue *mq = hctx->queue->queuedata;
+
+	if (mq)
+		mmc_mq_flush_inflight(mq);
+}
+
+static void mmc_mq_complete_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    complete_work);
+
+	mutex_lock(&mq->issue_mutex);
+	if (mq->mqrq_prev->req) {
+		mq->mqrq_cur->req = NULL;
+		mmc_queue_issue(mq, NULL);
+	}
+	mutex_unlock(&mq->issue_mutex);
+}
+
+/*
+ * Complete the request left in flight, once the queue is quiesced,
+ * without waiting for complete_work to get to it.
+ */
+static void mmc_mq_complete_inflight(struct mmc_queue *mq)
+{
+	cancel_work_sync(&mq->complete_work);
+	mmc_mq_complete_work(&mq->complete_work);
+}
+
 static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
 {
 	struct scatterlist *sg;
@@ -158,6 +276,296 @@ static struct scatterlist *mmc_alloc_sg(int sg_len, int *err)
 	return sg;
 }
 
+enum mmc_issue_type mmc_cqe_issue_type(struct mmc_queue *mq,
+				       struct request *req)
+{
+	if (req->cmd_flags & REQ_DISCARD)
+		return MMC_ISSUE_SYNC;
+
+	if (req->cmd_flags & REQ_FLUSH) {
+		if (mq->card->host->caps2 & MMC_CAP2_CQE_DCMD)
+			return MMC_ISSUE_DCMD;
+		return MMC_ISSUE_SYNC;
+	}
+
+	return MMC_ISSUE_ASYNC;
+}
+
+/*
+ * Account for a request of the given type that the command queue engine
+ * no longer owns, releasing the host along with the last one.  Called
+ * from softirq context on completion.
+ */
+void mmc_cqe_put(struct mmc_queue *mq, enum mmc_issue_type issue_type)
+{
+	struct request_queue *q = mq->queue;
+	unsigned long flags;
+	bool put_card, run_queue;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	mq->in_flight[issue_type] -= 1;
+	put_card = !mmc_tot_in_flight(mq);
+	run_queue = mq->cqe_busy && !mq->in_flight[MMC_ISSUE_DCMD];
+	if (run_queue)
+		mq->cqe_busy &= ~MMC_CQE_DCMD_BUSY;
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	if (run_queue)
+		blk_mq_run_hw_queues(q, true);
+
+	if (put_card)
+		mmc_release_host(mq->card->host);
+}
+
+static void __mmc_cqe_recovery_notifier(struct mmc_queue *mq)
+{
+	if (!mq->recovery_needed) {
+		mq->recovery_needed = true;
+		schedule_work(&mq->recovery_work);
+	}
+}
+
+void mmc_cqe_recovery_notifier(struct mmc_request *mrq)
+{
+	struct mmc_queue_req *mqrq = container_of(mrq, struct mmc_queue_req,
+						  brq.mrq);
+	struct request *req = mmc_queue_req_to_req(mqrq);
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->queuedata;
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	__mmc_cqe_recovery_notifier(mq);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+static void mmc_cqe_recovery_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    recovery_work);
+	struct request_queue *q = mq->queue;
+
+	mutex_lock(&mq->issue_mutex);
+	__mmc_claim_host(mq->card->host, &mq->ctx, NULL);
+
+	mq->ctx.task = current;
+	mq->in_recovery = true;
+	mmc_blk_cqe_recovery(mq);
+	mq->in_recovery = false;
+	mq->ctx.task = NULL;
+
+	spin_lock_irq(q->queue_lock);
+	mq->recovery_needed = false;
+	spin_unlock_irq(q->queue_lock);
+
+	mmc_release_host(mq->card->host);
+	mutex_unlock(&mq->issue_mutex);
+
+	blk_mq_run_hw_queues(q, true);
+}
+
+/*
+ * blk-mq request handler when the host has a command queue engine.  Reads
+ * and writes are queued to the engine as tasks tagged with the request
+ * tag and complete asynchronously; flushes go as a direct command if the
+ * engine can issue one.  Anything else waits for the engine to go idle
+ * and is issued synchronously through the regular path.  The host stays
+ * claimed by the queue while it owns any request.
+ */
+static int mmc_cqe_queue_rq(struct blk_mq_hw_ctx *hctx,
+			    const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->queuedata;
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+	enum mmc_issue_type issue_type;
+	bool get_card;
+	int ret;
+
+	if (!mq || mmc_prep_check(mq, req) != BLKPREP_OK) {
+		req->cmd_flags |= REQ_QUIET;
+		return BLK_MQ_RQ_QUEUE_ERROR;
+	}
+
+	if (!(req->cmd_flags & REQ_DONTPREP)) {
+		mqrq->retries = 0;
+		req->cmd_flags |= REQ_DONTPREP;
+	}
+
+	issue_type = mmc_cqe_issue_type(mq, req);
+
+	mutex_lock(&mq->issue_mutex);
+
+	spin_lock_irq(q->queue_lock);
+	if (mq->recovery_needed) {
+		/* the recovery work runs the queue once it is done */
+		spin_unlock_irq(q->queue_lock);
+		mutex_unlock(&mq->issue_mutex);
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
+	if (issue_type == MMC_ISSUE_DCMD && mq->in_flight[MMC_ISSUE_DCMD]) {
+		/* there is a single direct command slot */
+		mq->cqe_busy |= MMC_CQE_DCMD_BUSY;
+		spin_unlock_irq(q->queue_lock);
+		mutex_unlock(&mq->issue_mutex);
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	}
+	get_card = !mmc_tot_in_flight(mq);
+	mq->in_flight[issue_type] += 1;
+	spin_unlock_irq(q->queue_lock);
+
+	if (get_card)
+		__mmc_claim_host(mq->card->host, &mq->ctx, NULL);
+
+	/*
+	 * Synchronous requests cannot be aborted on timeout, so give them
+	 * all the time they need rather than race with their completion.
+	 */
+	if (issue_type == MMC_ISSUE_SYNC)
+		req->timeout = 600 * HZ;
+
+	blk_mq_start_request(req);
+
+	mq->ctx.task = current;
+	ret = mmc_blk_cqe_issue_rq(mq, req);
+	mq->ctx.task = NULL;
+
+	/* synchronous requests have been completed, failed ones not started */
+	if (issue_type == MMC_ISSUE_SYNC || ret)
+		mmc_cqe_put(mq, issue_type);
+
+	mutex_unlock(&mq->issue_mutex);
+
+	if (ret == -EBUSY)
+		return BLK_MQ_RQ_QUEUE_BUSY;
+	if (ret) {
+		req->cmd_flags |= REQ_QUIET;
+		return BLK_MQ_RQ_QUEUE_ERROR;
+	}
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static void mmc_cqe_complete(struct request *req)
+{
+	struct mmc_queue *mq = req->q->queuedata;
+
+	mmc_blk_cqe_complete_rq(mq, req);
+}
+
+static enum blk_eh_timer_return mmc_cqe_timed_out(struct request *req,
+						  bool reserved)
+{
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->queuedata;
+	struct mmc_host *host = mq->card->host;
+	enum blk_eh_timer_return ret = BLK_EH_RESET_TIMER;
+	bool recovery_needed = false;
+	unsigned long flags;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	/* synchronous requests time out in the mmc core */
+	if (!mq->recovery_needed &&
+	    mmc_cqe_issue_type(mq, req) != MMC_ISSUE_SYNC) {
+		if (host->cqe_ops->cqe_timeout(host, &mqrq->brq.mrq,
+					       &recovery_needed)) {
+			if (recovery_needed)
+				__mmc_cqe_recovery_notifier(mq);
+		} else {
+			/*
+			 * The request completed just as it timed out, and
+			 * that completion was dropped: complete it now.
+			 */
+			ret = BLK_EH_HANDLED;
+		}
+	}
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	return ret;
+}
+
+static int mmc_cqe_init_request(struct blk_mq_tag_set *set,
+				struct request *req, unsigned int hctx_idx,
+				unsigned int numa_node)
+{
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+	struct mmc_queue *mq = set->driver_data;
+	int ret;
+
+	mqrq->sg = mmc_alloc_sg(mq->card->host->max_segs, &ret);
+
+	return ret;
+}
+
+static void mmc_cqe_exit_request(struct blk_mq_tag_set *set,
+				 struct request *req, unsigned int hctx_idx)
+{
+	struct mmc_queue_req *mqrq = blk_mq_rq_to_pdu(req);
+
+	kfree(mqrq->sg);
+	mqrq->sg = NULL;
+}
+
+static struct blk_mq_ops mmc_cqe_mq_ops = {
+	.queue_rq	= mmc_cqe_queue_rq,
+	.complete	= mmc_cqe_complete,
+	.timeout	= mmc_cqe_timed_out,
+	.init_request	= mmc_cqe_init_request,
+	.exit_request	= mmc_cqe_exit_request,
+};
+
+static struct blk_mq_aux_ops mmc_mq_aux_ops = {
+	.commit_rqs	= mmc_mq_commit_rqs,
+};
+
+static struct blk_mq_ops mmc_mq_ops = {
+	.queue_rq	= mmc_mq_queue_rq,
+	.aux_ops	= &mmc_mq_aux_ops,
+};
+
+static struct request_queue *mmc_mq_init_queue(struct mmc_queue *mq,
+					       spinlock_t *lock)
+{
+	struct request_queue *q;
+	int ret;
+
+	memset(&mq->tag_set, 0, sizeof(mq->tag_set));
+	mq->tag_set.nr_hw_queues = 1;
+	mq->tag_set.numa_node = NUMA_NO_NODE;
+	if (mq->use_cqe) {
+		struct mmc_card *card = mq->card;
+
+		/* one tag per task slot both the card and the engine have */
+		mq->tag_set.ops = &mmc_cqe_mq_ops;
+		mq->tag_set.queue_depth = min_t(int, card->ext_csd.cmdq_depth,
+						card->host->cqe_qdepth);
+		mq->tag_set.cmd_size = sizeof(struct mmc_queue_req);
+		mq->tag_set.driver_data = mq;
+	} else {
+		mq->tag_set.ops = &mmc_mq_ops;
+		mq->tag_set.queue_depth = MMC_QUEUE_DEPTH;
+	}
+	/* issuing sleeps: claiming the host, waiting for the previous request */
+	mq->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_BLOCKING;
+
+	ret = blk_mq_alloc_tag_set(&mq->tag_set);
+	if (ret)
+		return NULL;
+
+	q = blk_mq_init_queue(&mq->tag_set);
+	if (IS_ERR(q)) {
+		blk_mq_free_tag_set(&mq->tag_set);
+		return NULL;
+	}
+
+	q->queue_lock = lock;
+	mutex_init(&mq->issue_mutex);
+	INIT_WORK(&mq->complete_work, mmc_mq_complete_work);
+	INIT_WORK(&mq->recovery_work, mmc_cqe_recovery_work);
+	return q;
+}
+
 static void mmc_queue_setup_discard(struct request_queue *q,
 				    struct mmc_card *card)
 {
@@ -202,7 +610,12 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 
 	mq->card = card;
     //struct request_queueʼstruct request_queue
-	mq->queue = blk_init_queue(mmc_request_fn, lock);
+	mq->use_mq = host->use_blk_mq;
+	mq->use_cqe = mq->use_mq && host->cqe_enabled;
+	if (mq->use_mq)
+		mq->queue = mmc_mq_init_queue(mq, lock);
+	else
+		mq->queue = blk_init_queue(mmc_request_fn, lock);
 	if (!mq->queue)
 		return -ENOMEM;
     //struct mmc_queue_reqֵ
@@ -210,13 +623,15 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->mqrq_prev = mqrq_prev;
 	mq->queue->queuedata = mq;
     //mq->queueprep_rq_fnֵΪmmc_prep_request
-	blk_queue_prep_rq(mq->queue, mmc_prep_request);
+	if (!mq->use_mq)
+		blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	if (mmc_can_erase(card))
 		mmc_queue_setup_discard(mq->queue, card);
 
 #ifdef CONFIG_MMC_BLOCK_BOUNCE
-	if (host->max_segs == 1) {
+	/* CQE requests map their data straight into their own sg list */
+	if (host->max_segs == 1 && !mq->use_cqe) {
 		unsigned int bouncesz;
 
 		bouncesz = MMC_QUEUE_BOUNCESZ;
@@ -289,6 +704,9 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 			goto cleanup_queue;
 	}
 
+	if (mq->use_mq)
+		return 0;
+
 	sema_init(&mq->thread_sem, 1);
     //"mmcqd/***"ں߳,߳ߵ
 	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
@@ -318,6 +736,8 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mqrq_prev->bounce_buf = NULL;
 
 	blk_cleanup_queue(mq->queue);
+	if (mq->use_mq)
+		blk_mq_free_tag_set(&mq->tag_set);
 	return ret;
 }
 
@@ -331,14 +751,34 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	/* Make sure the queue isn't suspended, as that will deadlock */
 	mmc_queue_resume(mq);
 
-	/* Then terminate our worker thread */
-	kthread_stop(mq->thread);
-
-	/* Empty the queue */
-	spin_lock_irqsave(q->queue_lock, flags);
-	q->queuedata = NULL;
-	blk_start_queue(q);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+	if (mq->use_cqe) {
+		/*
+		 * Wait for the command queue engine to complete everything
+		 * it owns, then fail any new requests.
+		 */
+		blk_mq_freeze_queue(q);
+		flush_work(&mq->recovery_work);
+		q->queuedata = NULL;
+		blk_mq_unfreeze_queue(q);
+	} else if (mq->use_mq) {
+		/*
+		 * Fail any new requests, wait for the submitters still
+		 * issuing and complete the request they left in flight.
+		 */
+		q->queuedata = NULL;
+		blk_mq_quiesce_queue(q);
+		mmc_mq_complete_inflight(mq);
+		blk_mq_unquiesce_queue(q);
+	} else {
+		/* Then terminate our worker thread */
+		kthread_stop(mq->thread);
+
+		/* Empty the queue */
+		spin_lock_irqsave(q->queue_lock, flags);
+		q->queuedata = NULL;
+		blk_start_queue(q);
+		spin_unlock_irqrestore(q->queue_lock, flags);
+	}
 
 	kfree(mqrq_cur->bounce_sg);
 	mqrq_cur->bounce_sg = NULL;
@@ -421,6 +861,22 @@ void mmc_queue_suspend(struct mmc_queue *mq)
 	if (!(mq->flags & MMC_QUEUE_SUSPENDED)) {
 		mq->flags |= MMC_QUEUE_SUSPENDED;
 
+		if (mq->use_cqe) {
+			/*
+			 * Quiescing would strand requests the engine has to
+			 * retry, so wait for every request to complete.
+			 */
+			blk_mq_freeze_queue(q);
+			return;
+		}
+
+		if (mq->use_mq) {
+			/* stop issuing and let the request in flight finish */
+			blk_mq_quiesce_queue(q);
+			mmc_mq_complete_inflight(mq);
+			return;
+		}
+
 		spin_lock_irqsave(q->queue_lock, flags);
 		blk_stop_queue(q);
 		spin_unlock_irqrestore(q->queue_lock, flags);
@@ -441,6 +897,16 @@ void mmc_queue_resume(struct mmc_queue *mq)
 	if (mq->flags & MMC_QUEUE_SUSPENDED) {
 		mq->flags &= ~MMC_QUEUE_SUSPENDED;
 
+		if (mq->use_cqe) {
+			blk_mq_unfreeze_queue(q);
+			return;
+		}
+
+		if (mq->use_mq) {
+			blk_mq_unquiesce_queue(q);
+			return;
+		}
+
 		up(&mq->thread_sem);
 
 		spin_lock_irqsave(q->queue_lock, flags);
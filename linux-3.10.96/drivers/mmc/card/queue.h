@@ -1,6 +1,9 @@
 #ifndef MMC_QUEUE_H
 #define MMC_QUEUE_H
 
+#include <linux/blk-mq.h>
+#include <linux/mmc/host.h>
+
 #define MMC_REQ_SPECIAL_MASK	(REQ_DISCARD | REQ_FLUSH)
 
 struct request;
@@ -19,6 +22,13 @@ enum mmc_packed_type {
 	MMC_PACKED_WRITE,
 };
 
+enum mmc_issue_type {
+	MMC_ISSUE_SYNC,
+	MMC_ISSUE_DCMD,
+	MMC_ISSUE_ASYNC,
+	MMC_ISSUE_MAX,
+};
+
 #define mmc_packed_cmd(type)	((type) != MMC_PACKED_NONE)
 #define mmc_packed_wr(type)	((type) == MMC_PACKED_WRITE)
 
@@ -41,6 +51,7 @@ struct mmc_queue_req {
 	struct mmc_async_req	mmc_active;
 	enum mmc_packed_type	cmd_type;
 	struct mmc_packed	*packed;
+	int			retries;
 };
 
 struct mmc_queue {
@@ -58,8 +69,41 @@ struct mmc_queue {
 	struct mmc_queue_req	mqrq[2];
 	struct mmc_queue_req	*mqrq_cur;
 	struct mmc_queue_req	*mqrq_prev;
+
+	/* context the host is claimed with while requests are issued */
+	struct mmc_ctx		ctx;
+	bool			use_mq;
+	/* blk-mq: serialises issuing, which is done by the submitters */
+	struct mutex		issue_mutex;
+	/* blk-mq: completes the request in flight when no more arrive */
+	struct work_struct	complete_work;
+	struct blk_mq_tag_set	tag_set;
+
+	/*
+	 * CQE: requests are issued to the host's command queue engine, one
+	 * mmc_queue_req per blk-mq request, and are counted per issue type.
+	 */
+	bool			use_cqe;
+	int			in_flight[MMC_ISSUE_MAX];
+	unsigned int		cqe_busy;
+#define MMC_CQE_DCMD_BUSY	(1 << 0)
+	bool			recovery_needed;
+	bool			in_recovery;
+	struct work_struct	recovery_work;
 };
 
+static inline struct request *mmc_queue_req_to_req(struct mmc_queue_req *mqr)
+{
+	return blk_mq_rq_from_pdu(mqr);
+}
+
+static inline int mmc_tot_in_flight(struct mmc_queue *mq)
+{
+	return mq->in_flight[MMC_ISSUE_SYNC] +
+	       mq->in_flight[MMC_ISSUE_DCMD] +
+	       mq->in_flight[MMC_ISSUE_ASYNC];
+}
+
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
 			  const char *);
 extern void mmc_cleanup_queue(struct mmc_queue *);
@@ -76,4 +120,9 @@ extern void mmc_packed_clean(struct mmc_queue *);
 
 extern int mmc_access_rpmb(struct mmc_queue *);
 
+extern enum mmc_issue_type mmc_cqe_issue_type(struct mmc_queue *,
+					      struct request *);
+extern void mmc_cqe_recovery_notifier(struct mmc_request *);
+extern void mmc_cqe_put(struct mmc_queue *, enum mmc_issue_type);
+
 #endif
@@ -32,6 +32,8 @@ void mmc_detach_bus(struct mmc_host *host);
 
 void mmc_init_erase(struct mmc_card *card);
 
+void mmc_cqe_disable(struct mmc_host *host);
+
 void mmc_set_chip_select(struct mmc_host *host, int mode);
 void mmc_set_clock(struct mmc_host *host, unsigned int hz);
 void mmc_gate_clock(struct mmc_host *host);
@@ -69,6 +71,7 @@ int mmc_attach_sdio(struct mmc_host *host);
 
 /* Module parameters */
 extern bool use_spi_crc;
+extern bool mmc_use_blk_mq;
 
 /* Debugfs information for hosts and cards */
 void mmc_add_host_debugfs(struct mmc_host *host);
@@ -29,6 +29,7 @@
 
 #include "core.h"
 #include "host.h"
+#include "swcq.h"
 
 #define cls_dev_to_mmc_host(d)	container_of(d, struct mmc_host, class_dev)
 
@@ -460,6 +461,7 @@ struct mmc_host *mmc_alloc_host(int extra, struct device *dev)
 	spin_lock_init(&host->lock);
 	init_waitqueue_head(&host->wq);
 	INIT_DELAYED_WORK(&host->detect, mmc_rescan);
+	host->use_blk_mq = mmc_use_blk_mq;
 #ifdef CONFIG_PM
 	host->pm_notify.notifier_call = mmc_pm_notify;
 #endif
@@ -510,6 +512,7 @@ int mmc_add_host(struct mmc_host *host)
 #endif
 	mmc_host_clk_sysfs_init(host);
 
+	mmc_swcq_attach(host);
 	mmc_start_host(host);
 	register_pm_notifier(&host->pm_notify);
 
@@ -530,6 +533,7 @@ void mmc_remove_host(struct mmc_host *host)
 {
 	unregister_pm_notifier(&host->pm_notify);
 	mmc_stop_host(host);
+	mmc_swcq_detach(host);
 
 #ifdef CONFIG_DEBUG_FS
 	mmc_remove_host_debugfs(host);
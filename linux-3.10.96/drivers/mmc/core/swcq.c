@@ -0,0 +1,590 @@
+/*
+ *  linux/drivers/mmc/core/swcq.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Software command queue engine.  Runs the eMMC command queue of the card
+ * the way a CQHCI does in hardware, but with the queued task commands
+ * issued one by one through the host's ->request(): CMD44/CMD45 to queue
+ * a task, CMD13 to read the queue status register and CMD46/CMD47 to
+ * execute a task the card reports ready.  Any host without a command
+ * queue engine can then run the CQE paths of the core and block driver,
+ * which is mostly useful to test them.  It is attached to hosts added
+ * while the mmc_core.swcq parameter is set.
+ */
+#include <linux/module.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+
+#include <linux/mmc/card.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
+
+#include "swcq.h"
+
+static bool mmc_use_swcq;
+module_param_named(swcq, mmc_use_swcq, bool, 0644);
+MODULE_PARM_DESC(
+	swcq,
+	"Queue eMMC tasks in software on hosts added from now on");
+
+#define SWCQ_NUM_SLOTS		32
+
+/* MMC_QUE_TASK_PARAMS argument */
+#define SWCQ_REL_WRITE		BIT(31)
+#define SWCQ_DATA_DIR_READ	BIT(30)
+#define SWCQ_DATA_TAG		BIT(29)
+#define SWCQ_FORCED_PRG		BIT(24)
+#define SWCQ_PRIORITY		BIT(23)
+#define SWCQ_TASK_ID(t)		((t) << 16)
+#define SWCQ_BLK_COUNT(n)	((n) & 0xffff)
+
+/* MMC_SEND_STATUS returns the queue status register instead */
+#define SWCQ_SEND_QSR		BIT(15)
+
+/* How long to sleep when no queued task is ready yet */
+#define SWCQ_POLL_MIN_US	20
+#define SWCQ_POLL_MAX_US	100
+
+#define SWCQ_CMD_ERRORS							\
+	(R1_OUT_OF_RANGE |	/* Command argument out of range */	\
+	 R1_ADDRESS_ERROR |	/* Misaligned address */		\
+	 R1_BLOCK_LEN_ERROR |	/* Transferred block length incorrect */\
+	 R1_WP_VIOLATION |	/* Tried to write to protected block */	\
+	 R1_CC_ERROR |		/* Card controller error */		\
+	 R1_ERROR)		/* General/unknown error */
+
+struct mmc_swcq_slot {
+	struct mmc_request *mrq;
+	unsigned int flags;
+#define SWCQ_COMPLETED		BIT(0)
+#define SWCQ_CRC		BIT(1)
+#define SWCQ_TIMEOUT		BIT(2)
+#define SWCQ_OTHER		BIT(3)
+};
+
+struct mmc_swcq {
+	struct mmc_host		*host;
+	u32			rca;
+	bool			enabled;
+	bool			recovery_halt;
+	bool			waiting_for_idle;
+	int			qcnt;
+	unsigned long		pending;	/* tasks to queue on the card */
+	unsigned long		queued;		/* tasks queued on the card */
+	spinlock_t		lock;
+	wait_queue_head_t	wait_queue;
+	struct workqueue_struct	*wq;
+	struct work_struct	work;
+	struct mmc_swcq_slot	slot[SWCQ_NUM_SLOTS];
+};
+
+static void mmc_swcq_wait_done(struct mmc_request *mrq)
+{
+	complete(&mrq->completion);
+}
+
+/*
+ * Send a command straight to the host: mmc_wait_for_cmd() would first
+ * hand the controller back from the engine.
+ */
+static int mmc_swcq_cmd(struct mmc_host *host, u32 opcode, u32 arg,
+			struct mmc_data *data, u32 *resp)
+{
+	struct mmc_command cmd = {0};
+	struct mmc_request mrq = {NULL};
+
+	cmd.opcode = opcode;
+	cmd.arg = arg;
+	cmd.flags = MMC_RSP_R1 | (data ? MMC_CMD_ADTC : MMC_CMD_AC);
+	cmd.data = data;
+	cmd.mrq = &mrq;
+
+	if (data) {
+		data->error = 0;
+		data->bytes_xfered = 0;
+		data->mrq = &mrq;
+	}
+
+	mrq.cmd = &cmd;
+	mrq.data = data;
+	mrq.done = mmc_swcq_wait_done;
+	mrq.host = host;
+	init_completion(&mrq.completion);
+
+	host->ops->request(host, &mrq);
+	wait_for_completion(&mrq.completion);
+
+	*resp = cmd.resp[0];
+	if (cmd.error)
+		return cmd.error;
+	if (data && data->error)
+		return data->error;
+	return 0;
+}
+
+static int mmc_swcq_queue_task(struct mmc_swcq *swcq, int tag)
+{
+	struct mmc_data *data = swcq->slot[tag].mrq->data;
+	u32 arg, status;
+	int err;
+
+	arg = SWCQ_TASK_ID(tag) | SWCQ_BLK_COUNT(data->blocks);
+	if (data->flags & MMC_DATA_READ)
+		arg |= SWCQ_DATA_DIR_READ;
+	if (data->flags & MMC_DATA_REL_WR)
+		arg |= SWCQ_REL_WRITE;
+	if (data->flags & MMC_DATA_DAT_TAG)
+		arg |= SWCQ_DATA_TAG;
+	if (data->flags & MMC_DATA_FORCED_PRG)
+		arg |= SWCQ_FORCED_PRG;
+	if (data->flags & MMC_DATA_PRIO)
+		arg |= SWCQ_PRIORITY;
+
+	err = mmc_swcq_cmd(swcq->host, MMC_QUE_TASK_PARAMS, arg, NULL,
+			   &status);
+	if (err)
+		return err;
+	if (status & SWCQ_CMD_ERRORS)
+		return -EIO;
+
+	err = mmc_swcq_cmd(swcq->host, MMC_QUE_TASK_ADDR, data->blk_addr,
+			   NULL, &status);
+	if (err)
+		return err;
+	return status & SWCQ_CMD_ERRORS ? -EIO : 0;
+}
+
+static int mmc_swcq_read_qsr(struct mmc_swcq *swcq, u32 *qsr)
+{
+	return mmc_swcq_cmd(swcq->host, MMC_SEND_STATUS,
+			    swcq->rca << 16 | SWCQ_SEND_QSR, NULL, qsr);
+}
+
+static int mmc_swcq_execute_task(struct mmc_swcq *swcq, int tag)
+{
+	struct mmc_request *mrq = swcq->slot[tag].mrq;
+	struct mmc_data *data = mrq->data;
+	u32 opcode, status;
+	int err;
+
+	opcode = (data->flags & MMC_DATA_READ) ? MMC_EXECUTE_READ_TASK :
+						 MMC_EXECUTE_WRITE_TASK;
+
+	err = mmc_swcq_cmd(swcq->host, opcode, SWCQ_TASK_ID(tag), data,
+			   &status);
+	data->mrq = mrq;
+	if (err)
+		return err;
+	return status & SWCQ_CMD_ERRORS ? -EIO : 0;
+}
+
+static unsigned int mmc_swcq_error_flags(int error)
+{
+	switch (error) {
+	case -EILSEQ:
+		return SWCQ_CRC;
+	case -ETIMEDOUT:
+		return SWCQ_TIMEOUT;
+	default:
+		return SWCQ_OTHER;
+	}
+}
+
+static int mmc_swcq_error_from_flags(unsigned int flags)
+{
+	if (!flags)
+		return 0;
+
+	/* CRC errors might indicate re-tuning so prefer to report that */
+	if (flags & SWCQ_CRC)
+		return -EILSEQ;
+
+	if (flags & SWCQ_TIMEOUT)
+		return -ETIMEDOUT;
+
+	return -EIO;
+}
+
+/* Called with swcq->lock held */
+static void mmc_swcq_recovery_needed(struct mmc_swcq *swcq,
+				     struct mmc_request *mrq, bool notify)
+{
+	if (!swcq->recovery_halt) {
+		swcq->recovery_halt = true;
+		pr_debug("%s: swcq: recovery needed\n",
+			 mmc_hostname(swcq->host));
+		wake_up(&swcq->wait_queue);
+		if (notify && mrq->recovery_notifier)
+			mrq->recovery_notifier(mrq);
+	}
+}
+
+static void mmc_swcq_task_error(struct mmc_swcq *swcq, int tag, int err)
+{
+	struct mmc_swcq_slot *slot = &swcq->slot[tag];
+
+	pr_debug("%s: swcq: tag %d error %d\n",
+		 mmc_hostname(swcq->host), tag, err);
+
+	slot->flags = mmc_swcq_error_flags(err);
+	mmc_swcq_recovery_needed(swcq, slot->mrq, true);
+}
+
+static void mmc_swcq_finish_mrq(struct mmc_swcq *swcq, int tag)
+{
+	struct mmc_swcq_slot *slot = &swcq->slot[tag];
+	struct mmc_request *mrq = slot->mrq;
+	struct mmc_data *data = mrq->data;
+
+	/* No completions allowed during recovery */
+	if (swcq->recovery_halt) {
+		slot->flags |= SWCQ_COMPLETED;
+		return;
+	}
+
+	slot->mrq = NULL;
+
+	swcq->qcnt -= 1;
+
+	data->bytes_xfered = data->blksz * data->blocks;
+
+	mmc_cqe_request_done(swcq->host, mrq);
+
+	if (swcq->waiting_for_idle && !swcq->qcnt) {
+		swcq->waiting_for_idle = false;
+		wake_up(&swcq->wait_queue);
+	}
+}
+
+/*
+ * The engine itself: queue every new task on the card first, so that the
+ * card is free to pick the order, then execute whichever task its queue
+ * status register reports ready.  Stops when the CQE is turned off or
+ * needs recovery, and when there is nothing left to do.
+ */
+static void mmc_swcq_work(struct work_struct *work)
+{
+	struct mmc_swcq *swcq = container_of(work, struct mmc_swcq, work);
+	struct mmc_host *host = swcq->host;
+	unsigned long flags, queued;
+	u32 qsr;
+	int tag, err;
+
+	spin_lock_irqsave(&swcq->lock, flags);
+	while (host->cqe_on && !swcq->recovery_halt) {
+		if (swcq->pending) {
+			tag = __ffs(swcq->pending);
+			swcq->pending &= ~BIT(tag);
+			spin_unlock_irqrestore(&swcq->lock, flags);
+
+			err = mmc_swcq_queue_task(swcq, tag);
+
+			spin_lock_irqsave(&swcq->lock, flags);
+			if (err)
+				mmc_swcq_task_error(swcq, tag, err);
+			else
+				swcq->queued |= BIT(tag);
+			continue;
+		}
+
+		queued = swcq->queued;
+		if (!queued)
+			break;
+		spin_unlock_irqrestore(&swcq->lock, flags);
+
+		err = mmc_swcq_read_qsr(swcq, &qsr);
+		if (err) {
+			spin_lock_irqsave(&swcq->lock, flags);
+			/*
+			 * The only way to guarantee forward progress is to
+			 * mark at least one task in error, so pick one.
+			 */
+			mmc_swcq_task_error(swcq, __ffs(queued), err);
+			continue;
+		}
+
+		qsr &= queued;
+		if (!qsr) {
+			usleep_range(SWCQ_POLL_MIN_US, SWCQ_POLL_MAX_US);
+			spin_lock_irqsave(&swcq->lock, flags);
+			continue;
+		}
+
+		tag = __ffs(qsr);
+		err = mmc_swcq_execute_task(swcq, tag);
+
+		spin_lock_irqsave(&swcq->lock, flags);
+		swcq->queued &= ~BIT(tag);
+		if (err)
+			mmc_swcq_task_error(swcq, tag, err);
+		else
+			mmc_swcq_finish_mrq(swcq, tag);
+	}
+	spin_unlock_irqrestore(&swcq->lock, flags);
+}
+
+static int mmc_swcq_enable(struct mmc_host *host, struct mmc_card *card)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+
+	swcq->rca = card->rca;
+	swcq->enabled = true;
+
+	return 0;
+}
+
+static void mmc_swcq_off(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+	unsigned long flags;
+
+	if (!swcq->enabled || !host->cqe_on || swcq->recovery_halt)
+		return;
+
+	spin_lock_irqsave(&swcq->lock, flags);
+	host->cqe_on = false;
+	spin_unlock_irqrestore(&swcq->lock, flags);
+
+	/* Let a command that is already on the bus finish */
+	flush_work(&swcq->work);
+
+	pr_debug("%s: swcq: CQE off\n", mmc_hostname(host));
+}
+
+static void mmc_swcq_disable(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+
+	if (!swcq->enabled)
+		return;
+
+	mmc_swcq_off(host);
+
+	swcq->enabled = false;
+}
+
+static int mmc_swcq_request(struct mmc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+	int tag = mrq->tag;
+	unsigned long flags;
+	int err = 0;
+
+	if (!swcq->enabled) {
+		pr_err("%s: swcq: not enabled\n", mmc_hostname(host));
+		return -EINVAL;
+	}
+
+	/* No direct command slot, MMC_CAP2_CQE_DCMD is never set */
+	if (WARN_ON(!mrq->data))
+		return -EINVAL;
+
+	spin_lock_irqsave(&swcq->lock, flags);
+
+	if (swcq->recovery_halt) {
+		err = -EBUSY;
+		goto out_unlock;
+	}
+
+	swcq->slot[tag].mrq = mrq;
+	swcq->slot[tag].flags = 0;
+	swcq->pending |= BIT(tag);
+
+	swcq->qcnt += 1;
+
+	if (!host->cqe_on) {
+		host->cqe_on = true;
+		pr_debug("%s: swcq: CQE on\n", mmc_hostname(host));
+	}
+	queue_work(swcq->wq, &swcq->work);
+
+out_unlock:
+	spin_unlock_irqrestore(&swcq->lock, flags);
+
+	return err;
+}
+
+static bool mmc_swcq_is_idle(struct mmc_swcq *swcq, int *ret)
+{
+	unsigned long flags;
+	bool is_idle;
+
+	spin_lock_irqsave(&swcq->lock, flags);
+	is_idle = !swcq->qcnt || swcq->recovery_halt;
+	*ret = swcq->recovery_halt ? -EBUSY : 0;
+	swcq->waiting_for_idle = !is_idle;
+	spin_unlock_irqrestore(&swcq->lock, flags);
+
+	return is_idle;
+}
+
+static int mmc_swcq_wait_for_idle(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+	int ret;
+
+	wait_event(swcq->wait_queue, mmc_swcq_is_idle(swcq, &ret));
+
+	return ret;
+}
+
+static bool mmc_swcq_timeout(struct mmc_host *host, struct mmc_request *mrq,
+			     bool *recovery_needed)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+	struct mmc_swcq_slot *slot = &swcq->slot[mrq->tag];
+	unsigned long flags;
+	bool timed_out;
+
+	spin_lock_irqsave(&swcq->lock, flags);
+	timed_out = slot->mrq == mrq;
+	if (timed_out) {
+		slot->flags |= SWCQ_TIMEOUT;
+		mmc_swcq_recovery_needed(swcq, mrq, false);
+		*recovery_needed = swcq->recovery_halt;
+	}
+	spin_unlock_irqrestore(&swcq->lock, flags);
+
+	if (timed_out)
+		pr_err("%s: swcq: timeout for tag %d\n",
+		       mmc_hostname(host), mrq->tag);
+
+	return timed_out;
+}
+
+static void mmc_swcq_recovery_start(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+
+	pr_debug("%s: swcq: %s\n", mmc_hostname(host), __func__);
+
+	WARN_ON(!swcq->recovery_halt);
+
+	/* The engine stops after its current command */
+	flush_work(&swcq->work);
+
+	host->cqe_on = false;
+}
+
+static void mmc_swcq_recover_mrq(struct mmc_swcq *swcq, int tag)
+{
+	struct mmc_swcq_slot *slot = &swcq->slot[tag];
+	struct mmc_request *mrq = slot->mrq;
+	struct mmc_data *data;
+
+	if (!mrq)
+		return;
+
+	slot->mrq = NULL;
+
+	swcq->qcnt -= 1;
+
+	data = mrq->data;
+	if (slot->flags & SWCQ_COMPLETED) {
+		data->bytes_xfered = data->blksz * data->blocks;
+	} else {
+		data->bytes_xfered = 0;
+		data->error = mmc_swcq_error_from_flags(slot->flags);
+	}
+
+	mmc_cqe_request_done(swcq->host, mrq);
+}
+
+static void mmc_swcq_recovery_finish(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+	unsigned long flags;
+	int tag;
+
+	pr_debug("%s: swcq: %s\n", mmc_hostname(host), __func__);
+
+	WARN_ON(!swcq->recovery_halt);
+
+	spin_lock_irqsave(&swcq->lock, flags);
+
+	/* mmc_cqe_recovery() has had the card discard its whole queue */
+	swcq->pending = 0;
+	swcq->queued = 0;
+
+	for (tag = 0; tag < SWCQ_NUM_SLOTS; tag++)
+		mmc_swcq_recover_mrq(swcq, tag);
+
+	WARN_ON(swcq->qcnt);
+
+	swcq->qcnt = 0;
+	swcq->recovery_halt = false;
+	host->cqe_on = false;
+
+	spin_unlock_irqrestore(&swcq->lock, flags);
+
+	pr_debug("%s: swcq: recovery done\n", mmc_hostname(host));
+}
+
+static const struct mmc_cqe_ops mmc_swcq_ops = {
+	.cqe_enable = mmc_swcq_enable,
+	.cqe_disable = mmc_swcq_disable,
+	.cqe_request = mmc_swcq_request,
+	.cqe_off = mmc_swcq_off,
+	.cqe_wait_for_idle = mmc_swcq_wait_for_idle,
+	.cqe_timeout = mmc_swcq_timeout,
+	.cqe_recovery_start = mmc_swcq_recovery_start,
+	.cqe_recovery_finish = mmc_swcq_recovery_finish,
+};
+
+/*
+ * Give a host without a command queue engine the software one, if asked
+ * to.  Called before the host starts detecting its card.
+ */
+void mmc_swcq_attach(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq;
+
+	if (!mmc_use_swcq || (host->caps2 & MMC_CAP2_CQE) ||
+	    mmc_host_is_spi(host))
+		return;
+
+	swcq = kzalloc(sizeof(*swcq), GFP_KERNEL);
+	if (!swcq)
+		return;
+
+	swcq->wq = alloc_ordered_workqueue("%s_swcq", WQ_MEM_RECLAIM,
+					   mmc_hostname(host));
+	if (!swcq->wq) {
+		kfree(swcq);
+		return;
+	}
+
+	swcq->host = host;
+	spin_lock_init(&swcq->lock);
+	init_waitqueue_head(&swcq->wait_queue);
+	INIT_WORK(&swcq->work, mmc_swcq_work);
+
+	host->cqe_private = swcq;
+	host->cqe_ops = &mmc_swcq_ops;
+	host->cqe_qdepth = SWCQ_NUM_SLOTS;
+	host->caps2 |= MMC_CAP2_CQE;
+
+	pr_info("%s: software command queue engine\n", mmc_hostname(host));
+}
+
+/* Called once the card is gone, which has disabled the engine */
+void mmc_swcq_detach(struct mmc_host *host)
+{
+	struct mmc_swcq *swcq = host->cqe_private;
+
+	if (host->cqe_ops != &mmc_swcq_ops)
+		return;
+
+	destroy_workqueue(swcq->wq);
+	kfree(swcq);
+
+	host->cqe_private = NULL;
+	host->cqe_ops = NULL;
+	host->caps2 &= ~MMC_CAP2_CQE;
+}
@@ -0,0 +1,25 @@
+/*
+ *  linux/drivers/mmc/core/swcq.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef _MMC_CORE_SWCQ_H
+#define _MMC_CORE_SWCQ_H
+
+struct mmc_host;
+
+#ifdef CONFIG_MMC_SWCQ
+void mmc_swcq_attach(struct mmc_host *host);
+void mmc_swcq_detach(struct mmc_host *host);
+#else
+static inline void mmc_swcq_attach(struct mmc_host *host)
+{
+}
+static inline void mmc_swcq_detach(struct mmc_host *host)
+{
+}
+#endif
+
+#endif
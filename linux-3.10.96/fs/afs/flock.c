@@ -273,8 +273,6 @@ static int afs_do_setlk(struct file *file, struct file_lock *fl)
 
 	type = (fl->fl_type == F_RDLCK) ? AFS_LOCK_READ : AFS_LOCK_WRITE;
 
-	lock_flocks();
-
 	/* make sure we've got a callback on this file and that our view of the
 	 * data version is up to date */
 	ret = afs_vnode_fetch_status(vnode, NULL, key);
@@ -420,7 +418,6 @@ given_lock:
 	afs_vnode_fetch_status(vnode, NULL, key);
 
 error:
-	unlock_flocks();
 	_leave(" = %d", ret);
 	return ret;
 
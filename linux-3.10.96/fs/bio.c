@@ -28,6 +28,8 @@
 #include <linux/mempool.h>
 #include <linux/workqueue.h>
 #include <linux/cgroup.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
 #include <scsi/sg.h>		/* for struct sg_iovec */
 
 #include <trace/events/block.h>
@@ -245,24 +247,229 @@ static void __bio_free(struct bio *bio)
 		bio_integrity_free(bio);
 }
 
+static void bio_free_pool(struct bio_set *bs, struct bio *bio)
+{
+	void *p;
+
+	if (bio_flagged(bio, BIO_OWNS_VEC))
+		bvec_free(bs->bvec_pool, bio->bi_io_vec, BIO_POOL_IDX(bio));
+
+	/*
+	 * If we have front padding, adjust the bio pointer before freeing
+	 */
+	p = bio;
+	p -= bs->front_pad;
+
+	mempool_free(p, bs->bio_pool);
+}
+
+/*
+ * Per-cpu cache of freed bios for bio_sets that asked for one. Bios are kept
+ * with their bvec array still attached, one list for bios using the inline
+ * vecs and one for each bvec slab below BIOVEC_MAX_IDX. Entries are only
+ * touched by the owning cpu with interrupts disabled, or with that cpu
+ * offline, or from bioset_free() when nobody can be allocating anymore.
+ */
+#define BIO_CACHE_SLOTS		(BIOVEC_MAX_IDX - 1)
+#define BIO_CACHE_MAX		32	/* bios per slot, per cpu */
+
+struct bio_alloc_cache {
+	struct bio *free_list[BIO_CACHE_SLOTS];
+	unsigned int nr[BIO_CACHE_SLOTS];
+};
+
+static DEFINE_MUTEX(bio_cache_lock);
+static LIST_HEAD(bio_cache_sets);
+
+/*
+ * Slot 0 holds inline vec bios, slot N bios owning a bvec from bvec_slabs[N + 1]
+ */
+static int bio_cache_slot(int nr_iovecs)
+{
+	int i;
+
+	if (nr_iovecs <= BIO_INLINE_VECS)
+		return 0;
+
+	for (i = 2; i < BIOVEC_MAX_IDX; i++)
+		if (nr_iovecs <= bvec_slabs[i].nr_vecs)
+			return i - 1;
+
+	return -1;
+}
+
+static int bio_cache_slot_of(struct bio *bio)
+{
+	unsigned long idx;
+
+	if (!bio_flagged(bio, BIO_OWNS_VEC))
+		return 0;
+
+	idx = BIO_POOL_IDX(bio);
+	if (idx < 2 || idx >= BIOVEC_MAX_IDX)
+		return -1;
+
+	return idx - 1;
+}
+
+static struct bio *bio_alloc_cache_get(struct bio_set *bs, int nr_iovecs)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags, idx;
+	struct bio_vec *bvl;
+	struct bio *bio;
+	int slot;
+
+	slot = bio_cache_slot(nr_iovecs);
+	if (slot < 0)
+		return NULL;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(bs->cache);
+	bio = cache->free_list[slot];
+	if (bio) {
+		cache->free_list[slot] = bio->bi_next;
+		cache->nr[slot]--;
+	}
+	local_irq_restore(flags);
+
+	if (!bio)
+		return NULL;
+
+	idx = BIO_POOL_IDX(bio);
+	bvl = bio->bi_io_vec;
+
+	bio_init(bio);
+	if (slot) {
+		bio->bi_flags |= 1 << BIO_OWNS_VEC;
+	} else {
+		idx = BIO_POOL_NONE;
+		bvl = nr_iovecs ? bio->bi_inline_vecs : NULL;
+	}
+
+	bio->bi_pool = bs;
+	bio->bi_flags |= idx << BIO_POOL_OFFSET;
+	bio->bi_max_vecs = nr_iovecs;
+	bio->bi_io_vec = bvl;
+	return bio;
+}
+
+static bool bio_alloc_cache_put(struct bio_set *bs, struct bio *bio)
+{
+	struct bio_alloc_cache *cache;
+	unsigned long flags;
+	bool ret = false;
+	int slot;
+
+	slot = bio_cache_slot_of(bio);
+	if (slot < 0)
+		return false;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(bs->cache);
+	if (cache->nr[slot] < BIO_CACHE_MAX) {
+		bio->bi_next = cache->free_list[slot];
+		cache->free_list[slot] = bio;
+		cache->nr[slot]++;
+		ret = true;
+	}
+	local_irq_restore(flags);
+
+	return ret;
+}
+
+static void bio_alloc_cache_prune(struct bio_set *bs,
+				  struct bio_alloc_cache *cache)
+{
+	struct bio *bio;
+	int i;
+
+	for (i = 0; i < BIO_CACHE_SLOTS; i++) {
+		while ((bio = cache->free_list[i]) != NULL) {
+			cache->free_list[i] = bio->bi_next;
+			bio_free_pool(bs, bio);
+		}
+		cache->nr[i] = 0;
+	}
+}
+
+/*
+ * Runs on each cpu from the shrinker, with bio_cache_lock held by the caller
+ */
+static void bio_alloc_cache_drain_local(void *unused)
+{
+	struct bio_set *bs;
+
+	list_for_each_entry(bs, &bio_cache_sets, cache_list)
+		bio_alloc_cache_prune(bs, this_cpu_ptr(bs->cache));
+}
+
+static unsigned long bio_alloc_cache_count(void)
+{
+	unsigned long count = 0;
+	struct bio_set *bs;
+	int cpu, i;
+
+	list_for_each_entry(bs, &bio_cache_sets, cache_list) {
+		for_each_possible_cpu(cpu) {
+			struct bio_alloc_cache *cache = per_cpu_ptr(bs->cache, cpu);
+
+			for (i = 0; i < BIO_CACHE_SLOTS; i++)
+				count += ACCESS_ONCE(cache->nr[i]);
+		}
+	}
+
+	return count;
+}
+
+static int bio_alloc_cache_shrink(struct shrinker *shrink,
+				  struct shrink_control *sc)
+{
+	unsigned long count;
+
+	mutex_lock(&bio_cache_lock);
+	count = bio_alloc_cache_count();
+	if (sc->nr_to_scan && count) {
+		on_each_cpu(bio_alloc_cache_drain_local, NULL, 1);
+		count = 0;
+	}
+	mutex_unlock(&bio_cache_lock);
+
+	return min_t(unsigned long, count, INT_MAX);
+}
+
+static struct shrinker bio_alloc_cache_shrinker = {
+	.shrink		= bio_alloc_cache_shrink,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+static int bio_alloc_cache_cpu_notify(struct notifier_block *self,
+				      unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long) hcpu;
+	struct bio_set *bs;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN) {
+		mutex_lock(&bio_cache_lock);
+		list_for_each_entry(bs, &bio_cache_sets, cache_list)
+			bio_alloc_cache_prune(bs, per_cpu_ptr(bs->cache, cpu));
+		mutex_unlock(&bio_cache_lock);
+	}
+
+	return NOTIFY_OK;
+}
+
 static void bio_free(struct bio *bio)
 {
 	struct bio_set *bs = bio->bi_pool;
-	void *p;
 
 	__bio_free(bio);
 
 	if (bs) {
-		if (bio_flagged(bio, BIO_OWNS_VEC))
-			bvec_free(bs->bvec_pool, bio->bi_io_vec, BIO_POOL_IDX(bio));
-
-		/*
-		 * If we have front padding, adjust the bio pointer before freeing
-		 */
-		p = bio;
-		p -= bs->front_pad;
+		if (bs->cache && bio_alloc_cache_put(bs, bio))
+			return;
 
-		mempool_free(p, bs->bio_pool);
+		bio_free_pool(bs, bio);
 	} else {
 		/* Bio was allocated by bio_kmalloc() */
 		kfree(bio);
@@ -273,6 +480,7 @@ void bio_init(struct bio *bio)
 {
 	memset(bio, 0, sizeof(*bio));
 	bio->bi_flags = 1 << BIO_UPTODATE;
+	bio->bi_cookie = BLK_QC_T_NONE;
 	atomic_set(&bio->bi_cnt, 1);
 }
 EXPORT_SYMBOL(bio_init);
@@ -295,6 +503,7 @@ void bio_reset(struct bio *bio)
 
 	memset(bio, 0, BIO_RESET_BYTES);
 	bio->bi_flags = flags|(1 << BIO_UPTODATE);
+	bio->bi_cookie = BLK_QC_T_NONE;
 }
 EXPORT_SYMBOL(bio_reset);
 
@@ -391,6 +600,12 @@ struct bio *bio_alloc_bioset(gfp_t gfp_mask, int nr_iovecs, struct bio_set *bs)
 	struct bio *bio;
 	void *p;
 
+	if (bs && bs->cache) {
+		bio = bio_alloc_cache_get(bs, nr_iovecs);
+		if (bio)
+			return bio;
+	}
+
 	if (!bs) {
 		if (nr_iovecs > UIO_MAXIOV)
 			return NULL;
@@ -1861,6 +2076,18 @@ mempool_t *biovec_create_pool(struct bio_set *bs, int pool_entries)
 
 void bioset_free(struct bio_set *bs)
 {
+	int cpu;
+
+	if (bs->cache) {
+		mutex_lock(&bio_cache_lock);
+		list_del(&bs->cache_list);
+		mutex_unlock(&bio_cache_lock);
+
+		for_each_possible_cpu(cpu)
+			bio_alloc_cache_prune(bs, per_cpu_ptr(bs->cache, cpu));
+		free_percpu(bs->cache);
+	}
+
 	if (bs->rescue_workqueue)
 		destroy_workqueue(bs->rescue_workqueue);
 
@@ -1930,6 +2157,33 @@ bad:
 }
 EXPORT_SYMBOL(bioset_create);
 
+/**
+ * bioset_enable_percpu_cache - keep freed bios of a bio_set in a per-cpu cache
+ * @bs:		bio_set to enable the cache for
+ *
+ * Description:
+ *    Bios freed from @bs are kept on a per-cpu list together with their
+ *    bvec array, and handed out again by bio_alloc_bioset() on that cpu
+ *    without going through the mempool and slab allocators. Meant for high
+ *    rate submitters like direct IO. Bios needing a BIO_MAX_PAGES bvec are
+ *    not cached. The cache is drained when a cpu goes offline and when the
+ *    VM asks for memory back.
+ *
+ *    Must be called before any bio is allocated from @bs.
+ */
+int bioset_enable_percpu_cache(struct bio_set *bs)
+{
+	bs->cache = alloc_percpu(struct bio_alloc_cache);
+	if (!bs->cache)
+		return -ENOMEM;
+
+	mutex_lock(&bio_cache_lock);
+	list_add(&bs->cache_list, &bio_cache_sets);
+	mutex_unlock(&bio_cache_lock);
+	return 0;
+}
+EXPORT_SYMBOL(bioset_enable_percpu_cache);
+
 #ifdef CONFIG_BLK_CGROUP
 /**
  * bio_associate_current - associate a bio with %current
@@ -2030,6 +2284,9 @@ static int __init init_bio(void)
 	if (!bio_split_pool)
 		panic("bio: can't create split pool\n");
 
+	register_shrinker(&bio_alloc_cache_shrinker);
+	hotcpu_notifier(bio_alloc_cache_cpu_notify, 0);
+
 	return 0;
 }
 subsys_initcall(init_bio);
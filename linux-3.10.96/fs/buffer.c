@@ -1731,7 +1731,7 @@ static int __block_write_full_page(struct inode *inode, struct page *page,
 	do {
 		struct buffer_head *next = bh->b_this_page;
 		if (buffer_async_write(bh)) {
-			submit_bh(write_op, bh);//submit_bio
+			_submit_bh(write_op, bh, wbc_to_bio_flags(wbc));//submit_bio
 			nr_underway++;
 		}
 		bh = next;
@@ -1786,7 +1786,7 @@ recover:
 		struct buffer_head *next = bh->b_this_page;
 		if (buffer_async_write(bh)) {
 			clear_buffer_dirty(bh);
-			submit_bh(write_op, bh);
+			_submit_bh(write_op, bh, wbc_to_bio_flags(wbc));
 			nr_underway++;
 		}
 		bh = next;
@@ -131,6 +131,8 @@ struct dio {
 	unsigned long refcount;		/* direct_io_worker() and bios */
 	struct bio *bio_list;		/* singly linked via bi_private */
 	struct task_struct *waiter;	/* waiting task (NULL if none) */
+	struct block_device *bio_bdev;	/* last bio submitted, for polling */
+	blk_qc_t bio_cookie;
 
 	/* AIO related stuff */
 	struct kiocb *iocb;		/* kiocb */
@@ -146,6 +148,12 @@ struct dio {
 
 static struct kmem_cache *dio_cache __read_mostly;
 
+/*
+ * Direct IO bios come from their own bio_set, so that they can be recycled
+ * through its per-cpu cache instead of the slab allocator.
+ */
+static struct bio_set *dio_bio_set __read_mostly;
+
 /*
  * How many pages are in the queue?
  */
@@ -343,10 +351,10 @@ dio_bio_alloc(struct dio *dio, struct dio_submit *sdio,
 	struct bio *bio;
 
 	/*
-	 * bio_alloc() is guaranteed to return a bio when called with
+	 * bio_alloc_bioset() is guaranteed to return a bio when called with
 	 * __GFP_WAIT and we request a valid number of vectors.
 	 */
-	bio = bio_alloc(GFP_KERNEL, nr_vecs);
+	bio = bio_alloc_bioset(GFP_KERNEL, nr_vecs, dio_bio_set);
 
 	bio->bi_bdev = bdev;
 	bio->bi_sector = first_sector;
@@ -380,11 +388,22 @@ static inline void dio_bio_submit(struct dio *dio, struct dio_submit *sdio)
 	if (dio->is_async && dio->rw == READ)
 		bio_set_pages_dirty(bio);
 
-	if (sdio->submit_io)
+	if (sdio->submit_io) {
 		sdio->submit_io(dio->rw, bio, dio->inode,
 			       sdio->logical_offset_in_bio);
-	else
+		dio->bio_bdev = NULL;
+	} else {
+		/*
+		 * A synchronous waiter may spin on the completion of this
+		 * bio instead of sleeping.  The bio stays referenced until
+		 * dio_await_one() reaps it, so the cookie is safe to read.
+		 */
+		if (!dio->is_async)
+			bio->bi_flags |= 1 << BIO_HIPRI;
 		submit_bio(dio->rw, bio);
+		dio->bio_bdev = bio->bi_bdev;
+		dio->bio_cookie = bio->bi_cookie;
+	}
 
 	sdio->bio = NULL;
 	sdio->boundary = 0;
@@ -423,7 +442,9 @@ static struct bio *dio_await_one(struct dio *dio)
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		dio->waiter = current;
 		spin_unlock_irqrestore(&dio->bio_lock, flags);
-		io_schedule();
+		if (!dio->bio_bdev ||
+		    !blk_poll(bdev_get_queue(dio->bio_bdev), dio->bio_cookie))
+			io_schedule();
 		/* wake up sets us TASK_RUNNING */
 		spin_lock_irqsave(&dio->bio_lock, flags);
 		dio->waiter = NULL;
@@ -1305,6 +1326,12 @@ EXPORT_SYMBOL(__blockdev_direct_IO);
 static __init int dio_init(void)
 {
 	dio_cache = KMEM_CACHE(dio, SLAB_PANIC);
+
+	dio_bio_set = bioset_create(BIO_POOL_SIZE, 0);
+	if (!dio_bio_set || bioset_enable_percpu_cache(dio_bio_set) ||
+	    bioset_integrity_create(dio_bio_set, BIO_POOL_SIZE))
+		panic("dio: can't allocate bios\n");
+
 	return 0;
 }
 module_init(dio_init)
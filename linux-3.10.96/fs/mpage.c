@@ -886,6 +886,7 @@ alloc_new:
 				bio_get_nr_vecs(bdev), GFP_NOFS|__GFP_HIGH);
 		if (bio == NULL)
 			goto confused;
+		bio->bi_flags |= wbc_to_bio_flags(wbc);
 	}
 
 	/*
@@ -36,6 +36,8 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/parser.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -47,6 +49,64 @@
 static struct file_system_type squashfs_fs_type;
 static const struct super_operations squashfs_super_ops;
 
+enum {
+	Opt_threads_single, Opt_threads_multi, Opt_threads_percpu, Opt_err
+};
+
+static const match_table_t tokens = {
+	{Opt_threads_single, "threads=single"},
+	{Opt_threads_multi, "threads=multi"},
+	{Opt_threads_percpu, "threads=percpu"},
+	{Opt_err, NULL}
+};
+
+#if defined(CONFIG_SQUASHFS_DECOMP_DEFAULT_PERCPU)
+#define squashfs_default_thread_ops	squashfs_decompressor_percpu
+#elif defined(CONFIG_SQUASHFS_DECOMP_DEFAULT_MULTI)
+#define squashfs_default_thread_ops	squashfs_decompressor_multi
+#else
+#define squashfs_default_thread_ops	squashfs_decompressor_single
+#endif
+
+/*
+ * Parse the mount options, returning the decompressor threading model
+ * to use (@thread_ops if none is given), or NULL if an option is not
+ * recognised.
+ */
+static const struct squashfs_decompressor_thread_ops *squashfs_parse_options(
+	char *options,
+	const struct squashfs_decompressor_thread_ops *thread_ops)
+{
+	substring_t args[MAX_OPT_ARGS];
+	char *p;
+
+	if (!options)
+		return thread_ops;
+
+	while ((p = strsep(&options, ",")) != NULL) {
+		if (!*p)
+			continue;
+
+		switch (match_token(p, tokens, args)) {
+		case Opt_threads_single:
+			thread_ops = &squashfs_decompressor_single;
+			break;
+		case Opt_threads_multi:
+			thread_ops = &squashfs_decompressor_multi;
+			break;
+		case Opt_threads_percpu:
+			thread_ops = &squashfs_decompressor_percpu;
+			break;
+		default:
+			ERROR("Unrecognised mount option \"%s\"\n", p);
+			return NULL;
+		}
+	}
+
+	return thread_ops;
+}
+
+
 static const struct squashfs_decompressor *supported_squashfs_filesystem(short
 	major, short minor, short id)
 {
@@ -98,7 +158,14 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	msblk->devblksize = sb_min_blocksize(sb, SQUASHFS_DEVBLK_SIZE);
 	msblk->devblksize_log2 = ffz(~msblk->devblksize);
 
-	mutex_init(&msblk->read_data_mutex);
+	msblk->thread_ops = squashfs_parse_options(data,
+					&squashfs_default_thread_ops);
+	if (msblk->thread_ops == NULL) {
+		kfree(sb->s_fs_info);
+		sb->s_fs_info = NULL;
+		return -EINVAL;
+	}
+
 	mutex_init(&msblk->meta_index_mutex);
 
 	/*
@@ -205,14 +272,15 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
-	/* Allocate read_page block */
-	msblk->read_page = squashfs_cache_init("data", 1, msblk->block_size);
+	/* Allocate read_page block, one per decompressor that can run at once */
+	msblk->read_page = squashfs_cache_init("data",
+		squashfs_max_decompressors(msblk), msblk->block_size);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
 	}
 
-	msblk->stream = squashfs_decompressor_init(sb, flags);
+	msblk->stream = squashfs_decompressor_setup(sb, flags);
 	if (IS_ERR(msblk->stream)) {
 		err = PTR_ERR(msblk->stream);
 		msblk->stream = NULL;
@@ -336,7 +404,7 @@ failed_mount:
 	squashfs_cache_delete(msblk->block_cache);
 	squashfs_cache_delete(msblk->fragment_cache);
 	squashfs_cache_delete(msblk->read_page);
-	squashfs_decompressor_free(msblk, msblk->stream);
+	squashfs_decompressor_destroy(msblk);
 	kfree(msblk->inode_lookup_table);
 	kfree(msblk->fragment_index);
 	kfree(msblk->id_table);
@@ -371,11 +439,33 @@ static int squashfs_statfs(struct dentry *dentry, struct kstatfs *buf)
 
 static int squashfs_remount(struct super_block *sb, int *flags, char *data)
 {
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	const struct squashfs_decompressor_thread_ops *thread_ops;
+
+	/* the threading model is fixed once the streams have been created */
+	thread_ops = squashfs_parse_options(data, msblk->thread_ops);
+	if (thread_ops == NULL)
+		return -EINVAL;
+	if (thread_ops != msblk->thread_ops) {
+		ERROR("Cannot change decompressor threads on remount\n");
+		return -EINVAL;
+	}
+
 	*flags |= MS_RDONLY;
 	return 0;
 }
 
 
+static int squashfs_show_options(struct seq_file *seq, struct dentry *root)
+{
+	struct squashfs_sb_info *msblk = root->d_sb->s_fs_info;
+
+	if (msblk->thread_ops != &squashfs_default_thread_ops)
+		seq_printf(seq, ",threads=%s", msblk->thread_ops->name);
+	return 0;
+}
+
+
 static void squashfs_put_super(struct super_block *sb)
 {
 	if (sb->s_fs_info) {
@@ -383,7 +473,7 @@ static void squashfs_put_super(struct super_block *sb)
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
-		squashfs_decompressor_free(sbi, sbi->stream);
+		squashfs_decompressor_destroy(sbi);
 		kfree(sbi->id_table);
 		kfree(sbi->fragment_index);
 		kfree(sbi->meta_index);
@@ -496,7 +586,8 @@ static const struct super_operations squashfs_super_ops = {
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
 	.put_super = squashfs_put_super,
-	.remount_fs = squashfs_remount
+	.remount_fs = squashfs_remount,
+	.show_options = squashfs_show_options
 };
 
 module_init(init_squashfs_fs);
@@ -221,6 +221,7 @@ extern void bio_pair_release(struct bio_pair *dbio);
 
 extern struct bio_set *bioset_create(unsigned int, unsigned int);
 extern void bioset_free(struct bio_set *);
+extern int bioset_enable_percpu_cache(struct bio_set *);
 extern mempool_t *biovec_create_pool(struct bio_set *bs, int pool_entries);
 
 extern struct bio *bio_alloc_bioset(gfp_t, int, struct bio_set *);
@@ -527,6 +528,8 @@ static inline struct bio *bio_list_get(struct bio_list *bl)
 #define BIOVEC_NR_POOLS 6
 #define BIOVEC_MAX_IDX	(BIOVEC_NR_POOLS - 1)
 
+struct bio_alloc_cache;
+
 struct bio_set {
 	struct kmem_cache *bio_slab;
 	unsigned int front_pad;
@@ -546,6 +549,13 @@ struct bio_set {
 	struct bio_list		rescue_list;
 	struct work_struct	rescue_work;
 	struct workqueue_struct	*rescue_workqueue;
+
+	/*
+	 * Optional per-cpu cache of freed bios, see
+	 * bioset_enable_percpu_cache()
+	 */
+	struct bio_alloc_cache __percpu *cache;
+	struct list_head	cache_list;
 };
 
 struct biovec_slab {
@@ -114,6 +114,10 @@ struct blk_mq_hw_ctx {
 	//RH_KABI_EXTEND(int			dispatch_busy)
 	//ӦǱʾӲзæblk_mq_update_dispatch_busy()÷æ
 	int			dispatch_busy;
+
+	unsigned long		poll_considered;
+	unsigned long		poll_invoked;
+	unsigned long		poll_success;
 };
 
 #ifdef __GENKSYMS__
@@ -200,6 +204,8 @@ typedef void (busy_iter_fn)(struct blk_mq_hw_ctx *, struct request *, void *,
 		bool);
 typedef void (busy_tag_iter_fn)(struct request *, void *, bool);
 typedef int (map_queues_fn)(struct blk_mq_tag_set *set);
+typedef int (poll_fn)(struct blk_mq_hw_ctx *, unsigned int);
+typedef void (commit_rqs_fn)(struct blk_mq_hw_ctx *);
 
 struct blk_mq_aux_ops {
 	reinit_request_fn	*reinit_request;
@@ -213,6 +219,19 @@ struct blk_mq_aux_ops {
 	 */
 	get_budget_fn		*get_budget;
 	put_budget_fn		*put_budget;
+
+	/*
+	 * Reap completions on the hardware queue without waiting for an
+	 * interrupt.  Returns > 0 once the request with the given tag has
+	 * completed, 0 to keep polling and < 0 to stop.
+	 */
+	poll_fn			*poll;
+
+	/*
+	 * Called when dispatch stopped after a request was queued with
+	 * bd->last == false, so the driver can kick what it is holding.
+	 */
+	commit_rqs_fn		*commit_rqs;
 };
 //nvme_dev_add()Ϊnvme_mq_ops
 struct blk_mq_ops {
@@ -377,6 +396,24 @@ void blk_mq_delay_kick_requeue_list(struct request_queue *q, unsigned long msecs
 void blk_mq_complete_request(struct request *rq, int error);
 void blk_mq_complete_request_sync(struct request *rq, int error);
 
+/*
+ * Completions reaped together by a driver, linked through
+ * request->queuelist.  See blk_mq_add_to_batch().
+ */
+struct io_comp_batch {
+	struct list_head req_list;
+};
+
+#define DEFINE_IO_COMP_BATCH(name)					\
+	struct io_comp_batch name = {					\
+		.req_list = LIST_HEAD_INIT(name.req_list),		\
+	}
+
+bool blk_mq_add_to_batch(struct request *rq, struct io_comp_batch *iob,
+			 int error);
+void blk_mq_complete_batch(struct io_comp_batch *iob);
+void blk_mq_end_request_batch(struct io_comp_batch *iob);
+
 bool blk_mq_queue_stopped(struct request_queue *q);
 void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx);
 void blk_mq_start_hw_queue(struct blk_mq_hw_ctx *hctx);
@@ -426,6 +463,16 @@ static inline struct request_aux *rq_aux(struct request *rq)
 {
 	return __rq_aux(rq, rq->q);
 }
+
+static inline blk_qc_t request_to_qc_t(struct blk_mq_hw_ctx *hctx,
+				       struct request *rq)
+{
+	if (rq->tag != -1)
+		return blk_tag_to_qc_t(rq->tag, hctx->queue_num, false);
+
+	return blk_tag_to_qc_t(rq_aux(rq)->internal_tag, hctx->queue_num,
+			       true);
+}
 //ǸӲδq->queue_hw_ctx[i]ȡӲнṹ
 #define queue_for_each_hw_ctx(q, hctx, i)				\
 	for ((i) = 0; (i) < (q)->nr_hw_queues &&			\
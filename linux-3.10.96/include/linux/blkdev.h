@@ -38,6 +38,8 @@ struct blk_flush_queue;
 struct pr_ops;
 struct blk_queue_stats;
 struct blk_stat_callback;
+struct rq_wb;
+struct blk_iolatency;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_MAX_RQ	128	/* Default maximum */
@@ -46,7 +48,7 @@ struct blk_stat_callback;
  * Maximum number of blkcg policies allowed to be registered concurrently.
  * Defined here to simplify include dependency.
  */
-#define BLKCG_MAX_POLS		2//ӦblockֿƲ
+#define BLKCG_MAX_POLS		3//ӦblockֿƲ
 
 struct request;
 typedef void (rq_end_io_fn)(struct request *, int);
@@ -205,6 +207,9 @@ struct request {
 	struct request_list *rl;		/* rl this rq is alloced from */
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	struct blkcg_gq *iolat_blkg;		/* blkg charged by blk-iolatency */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -253,6 +258,12 @@ struct request {
 
 	/* for bidi */
 	struct request *next_rq;//һreq
+
+	/*
+	 * issue time and wbt state for the legacy request path, blk-mq
+	 * keeps this in the request_aux instead
+	 */
+	struct blk_issue_stat issue_stat;
 };
 
 #define req_op(req)		(op_from_rq_bits((req)->cmd_flags))
@@ -573,6 +584,9 @@ struct request_queue {
 #ifdef CONFIG_BLK_CGROUP
 	struct list_head	all_q_node;
 #endif
+#ifdef CONFIG_BLK_CGROUP_IOLATENCY
+	struct blk_iolatency	*blkiolat;
+#endif
 #ifdef CONFIG_BLK_DEV_THROTTLING
 	/* Throttle data */
 	struct throtl_data *td;//blk_throtl_initз
@@ -606,6 +620,10 @@ struct request_queue {
 	//RH_KABI_EXTEND(struct blk_stat_callback	*poll_cb)
 	struct blk_stat_callback	*poll_cb;
 	RH_KABI_EXTEND(struct blk_rq_stat	poll_stat[2])
+	/* hybrid polling sleep: -1 classic polling, 0 adaptive, else in ns */
+	int			poll_nsec;
+	/* writeback throttling state, see block/blk-wbt.c */
+	struct rq_wb		*rq_wb;
 	RH_KABI_EXTEND(atomic_t		shared_hctx_restart)
 	//RH_KABI_EXTEND(unsigned int		queue_depth)
 	unsigned int		queue_depth;
@@ -673,6 +691,7 @@ struct request_queue {
 #define QUEUE_FLAG_PREEMPT_ONLY	28	/* only process REQ_PREEMPT requests */
 #define QUEUE_FLAG_QUIESCED    29	/* queue has been quiesced */
 #define QUEUE_FLAG_SCSI_PASSTHROUGH 30	/* queue supports SCSI commands */
+#define QUEUE_FLAG_POLL	       31	/* IO polling enabled if set */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_STACKABLE)	|	\
@@ -777,6 +796,7 @@ extern void blk_clear_preempt_only(struct request_queue *q);
 	((rq)->cmd_flags & (REQ_FAILFAST_DEV|REQ_FAILFAST_TRANSPORT| \
 			     REQ_FAILFAST_DRIVER))
 #define blk_queue_quiesced(q)	test_bit(QUEUE_FLAG_QUIESCED, &(q)->queue_flags)
+#define blk_queue_poll(q)	test_bit(QUEUE_FLAG_POLL, &(q)->queue_flags)
 
 #define blk_account_rq(rq) \
 	(((rq)->cmd_flags & REQ_STARTED) && \
@@ -1042,6 +1062,7 @@ extern void __blk_stop_queue(struct request_queue *q);
 extern void __blk_run_queue(struct request_queue *q);
 extern void blk_run_queue(struct request_queue *);
 extern void blk_run_queue_async(struct request_queue *q);
+extern bool blk_poll(struct request_queue *q, blk_qc_t cookie);
 extern int blk_rq_map_user(struct request_queue *, struct request *,
 			   struct rq_map_data *, void __user *, unsigned long,
 			   gfp_t);
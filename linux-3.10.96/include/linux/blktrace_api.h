@@ -24,6 +24,11 @@ struct blk_trace {
 	struct dentry *dropped_file;
 	struct dentry *msg_file;
 	atomic_t dropped;
+	/* compact mode, see BLKTRACESETUPCOMPACT */
+	struct blk_trace_compact_buf *compact;
+	u32 compact_nr;
+	u32 sample;
+	struct cgroup_subsys_state *css;
 };
 
 extern int blk_trace_ioctl(struct block_device *, unsigned, char __user *);
@@ -112,6 +112,11 @@ struct mmc_data {
 #define MMC_DATA_WRITE	(1 << 8)
 #define MMC_DATA_READ	(1 << 9)
 #define MMC_DATA_STREAM	(1 << 10)
+#define MMC_DATA_QBR		(1 << 11)	/* CQE queue barrier */
+#define MMC_DATA_PRIO		(1 << 12)	/* CQE high priority */
+#define MMC_DATA_REL_WR		(1 << 13)	/* Reliable write */
+#define MMC_DATA_DAT_TAG	(1 << 14)	/* Tag request */
+#define MMC_DATA_FORCED_PRG	(1 << 15)	/* Forced programming */
 
 	unsigned int		bytes_xfered;
 
@@ -121,9 +126,11 @@ struct mmc_data {
 	unsigned int		sg_len;		/* size of scatter list */
 	struct scatterlist	*sg;		/* I/O scatter list */
 	s32			host_cookie;	/* host private data */
+	u32			blk_addr;	/* CQE block address */
 };
 
 struct mmc_host;
+struct mmc_ctx;
 struct mmc_request {
 	struct mmc_command	*sbc;		/* SET_BLOCK_COUNT for multiblock */
 	struct mmc_command	*cmd;
@@ -132,7 +139,15 @@ struct mmc_request {
 
 	struct completion	completion;
 	void			(*done)(struct mmc_request *);/* completion function */
+	/*
+	 * Notify uppers layers (e.g. mmc block driver) that recovery is needed
+	 * due to an error associated with the mmc_request. Currently used only
+	 * by CQE.
+	 */
+	void			(*recovery_notifier)(struct mmc_request *);
 	struct mmc_host		*host;
+
+	int			tag;		/* CQE task id */
 };
 
 struct mmc_card;
@@ -142,6 +157,9 @@ extern int mmc_stop_bkops(struct mmc_card *);
 extern int mmc_read_bkops_status(struct mmc_card *);
 extern struct mmc_async_req *mmc_start_req(struct mmc_host *,
 					   struct mmc_async_req *, int *);
+extern int mmc_cqe_start_req(struct mmc_host *host, struct mmc_request *mrq);
+extern void mmc_cqe_post_req(struct mmc_host *host, struct mmc_request *mrq);
+extern int mmc_cqe_recovery(struct mmc_host *host);
 extern int mmc_interrupt_hpi(struct mmc_card *);
 extern void mmc_wait_for_req(struct mmc_host *, struct mmc_request *);
 extern int mmc_wait_for_cmd(struct mmc_host *, struct mmc_command *, int);
@@ -152,6 +170,8 @@ extern void mmc_start_bkops(struct mmc_card *card, bool from_exception);
 extern int __mmc_switch(struct mmc_card *, u8, u8, u8, unsigned int, bool);
 extern int mmc_switch(struct mmc_card *, u8, u8, u8, unsigned int);
 extern int mmc_send_ext_csd(struct mmc_card *card, u8 *ext_csd);
+extern int mmc_cmdq_enable(struct mmc_card *card);
+extern int mmc_cmdq_disable(struct mmc_card *card);
 
 #define MMC_ERASE_ARG		0x00000000
 #define MMC_SECURE_ERASE_ARG	0x80000000
@@ -184,7 +204,8 @@ extern int mmc_can_reset(struct mmc_card *card);
 extern void mmc_set_data_timeout(struct mmc_data *, const struct mmc_card *);
 extern unsigned int mmc_align_data_size(struct mmc_card *, unsigned int);
 
-extern int __mmc_claim_host(struct mmc_host *host, atomic_t *abort);
+extern int __mmc_claim_host(struct mmc_host *host, struct mmc_ctx *ctx,
+			    atomic_t *abort);
 extern void mmc_release_host(struct mmc_host *host);
 extern int mmc_try_claim_host(struct mmc_host *host);
 
@@ -200,7 +221,7 @@ extern int mmc_detect_card_removed(struct mmc_host *host);
  */
 static inline void mmc_claim_host(struct mmc_host *host)
 {
-	__mmc_claim_host(host, NULL);
+	__mmc_claim_host(host, NULL, NULL);
 }
 
 extern u32 mmc_vddrange_to_ocrmask(int vdd_min, int vdd_max);
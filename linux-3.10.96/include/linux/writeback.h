@@ -80,6 +80,21 @@ struct writeback_control {
 	unsigned range_cyclic:1;	/* range_start is cyclic */
 };
 
+/*
+ * bio flags for IO issued on behalf of @wbc. Periodic and background
+ * writeback is tagged so the block layer can throttle it against
+ * foreground IO, data integrity writeback never is.
+ */
+static inline unsigned long wbc_to_bio_flags(struct writeback_control *wbc)
+{
+#ifdef CONFIG_BLOCK
+	if (wbc->sync_mode == WB_SYNC_NONE &&
+	    (wbc->for_kupdate || wbc->for_background))
+		return 1UL << BIO_BACKGROUND;
+#endif
+	return 0;
+}
+
 /*
  * fs/fs-writeback.c
  */	
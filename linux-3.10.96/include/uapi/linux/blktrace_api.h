@@ -109,6 +109,40 @@ struct blk_io_trace {
 	__u16 pdu_len;		/* length of data after this trace */
 };
 
+/*
+ * Compact trace record, written to the per-cpu rings set up with
+ * BLKTRACESETUPCOMPACT. Fixed size, no pdu; the cpu is implied by the
+ * ring and the device by the trace.
+ */
+struct blk_io_trace_compact {
+	__u64 time;		/* in nanoseconds */
+	__u64 sector;		/* disk offset */
+	__u32 bytes;		/* transfer length */
+	__u32 action;		/* what happened */
+	__u32 pid;		/* who did it */
+	__u16 error;		/* completion error */
+	__u16 __pad;
+};
+
+#define BLK_IO_TRACE_COMPACT_VERSION	0x01
+
+/*
+ * Header of a compact per-cpu ring, in the first page of the mapping.
+ * nr_records struct blk_io_trace_compact follow at offset PAGE_SIZE.
+ * The kernel advances head once a record is written, the consumer
+ * advances tail once it is done with a record. Record n lives in slot
+ * n & (nr_records - 1). When head - tail == nr_records new records are
+ * dropped and counted.
+ */
+struct blk_trace_compact_ring {
+	__u32 version;
+	__u32 nr_records;
+	__u64 dropped;
+	__u64 head;		/* written by the kernel */
+	__u64 __pad[5];
+	__u64 tail;		/* written by the consumer */
+};
+
 /*
  * The remap event
  */
@@ -139,4 +173,21 @@ struct blk_user_trace_setup {
 	__u32 pid;
 };
 
+/*
+ * User setup structure passed with BLKTRACESETUPCOMPACT. Same layout on
+ * 32 and 64 bit.
+ */
+struct blk_user_compact_trace_setup {
+	char name[BLKTRACE_BDEV_SIZE];	/* output */
+	__u16 act_mask;			/* input */
+	__u16 __pad1;
+	__u32 nr_records;		/* per-cpu ring size, power of 2 */
+	__u32 sample;			/* trace 1 in N I/Os, 0 or 1 for all */
+	__s32 cgroup_fd;		/* blkio cgroup dir, -1 for none */
+	__u64 start_lba;
+	__u64 end_lba;
+	__u32 pid;
+	__u32 __pad2;
+};
+
 #endif /* _UAPIBLKTRACE_H */
@@ -26,6 +26,11 @@
 #include <linux/export.h>
 #include <linux/time.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+#include <linux/file.h>
+#include <linux/cgroup.h>
+#include <linux/log2.h>
 
 #include <trace/events/block.h>
 
@@ -182,6 +187,108 @@ static const u32 ddir_act[2] = { BLK_TC_ACT(BLK_TC_READ),
 #define MASK_TC_BIT(rw, __name) ((rw & REQ_ ## __name) << \
 	  (ilog2(BLK_TC_ ## __name) + BLK_TC_SHIFT - __REQ_ ## __name))
 
+/*
+ * Compact mode: fixed size records go to a plain per-cpu ring that user
+ * space maps, see struct blk_trace_compact_ring. The ring is only written
+ * by its own cpu with interrupts disabled, so no lock and no subbuffer
+ * switching is needed. The header page is mapped writable, so head and
+ * dropped are kept here and only copied out to it.
+ */
+#define BLK_TRACE_COMPACT_DEF_NR	4096
+#define BLK_TRACE_COMPACT_MAX_NR	(1U << 20)
+
+struct blk_trace_compact_buf {
+	struct blk_trace_compact_ring *ring;
+	struct dentry *file;
+	u64 head;
+	u64 dropped;
+};
+
+static inline struct blk_io_trace_compact *
+compact_record(struct blk_trace_compact_ring *ring, u32 nr, u64 pos)
+{
+	struct blk_io_trace_compact *t = (void *) ring + PAGE_SIZE;
+
+	return t + (pos & (nr - 1));
+}
+
+static void blk_compact_add_trace(struct blk_trace *bt, sector_t sector,
+				  int bytes, u32 what, int error, pid_t pid)
+{
+	struct blk_trace_compact_buf *buf;
+	struct blk_trace_compact_ring *ring;
+	struct blk_io_trace_compact *t;
+	unsigned long flags;
+	u64 head;
+
+	/*
+	 * Sample on the sector, so that all the events of a sampled I/O
+	 * make it into the trace
+	 */
+	if (bt->sample > 1 && (u32) hash_64(sector, 32) % bt->sample)
+		return;
+
+	local_irq_save(flags);
+	buf = &bt->compact[smp_processor_id()];
+	ring = buf->ring;
+	head = buf->head;
+
+	/*
+	 * The slot is only written if the consumer moved tail past it;
+	 * the store depends on that load, and the consumer orders its
+	 * reads of the record before the tail update.
+	 */
+	if (head - ACCESS_ONCE(ring->tail) >= bt->compact_nr) {
+		ring->dropped = ++buf->dropped;
+	} else {
+		t = compact_record(ring, bt->compact_nr, head);
+		t->time = ktime_to_ns(ktime_get());
+		t->sector = sector;
+		t->bytes = bytes;
+		t->action = what;
+		t->pid = pid;
+		t->error = error;
+		t->__pad = 0;
+
+		smp_wmb();
+		buf->head = head + 1;
+		ring->head = buf->head;
+	}
+
+	local_irq_restore(flags);
+}
+
+/*
+ * Only trace I/O from the blkio cgroup given at setup time. Bios that
+ * were never associated with a cgroup are attributed to the submitter,
+ * when known.
+ */
+static bool blk_trace_bio_skip(struct blk_trace *bt, struct bio *bio)
+{
+#ifdef CONFIG_BLK_CGROUP
+	struct cgroup_subsys_state *css;
+	bool skip;
+
+	if (likely(!bt->css))
+		return false;
+	if (!bio)
+		return true;
+
+	css = bio->bi_css;
+	if (css)
+		return css != bt->css;
+	if (in_interrupt())
+		return true;
+
+	rcu_read_lock();
+	skip = task_subsys_state(current, blkio_subsys_id) != bt->css;
+	rcu_read_unlock();
+	return skip;
+#else
+	return false;
+#endif
+}
+
 /*
  * The worker for the various blk_add_trace*() types. Fills out a
  * blk_io_trace structure and places it in a per-cpu subbuffer.
@@ -213,6 +320,14 @@ static void __blk_add_trace(struct blk_trace *bt, sector_t sector, int bytes,
 	pid = tsk->pid;
 	if (act_log_check(bt, what, sector, pid))
 		return;
+
+	if (bt->compact) {
+		if (bt->trace_state == Blktrace_running)
+			blk_compact_add_trace(bt, sector, bytes, what, error,
+					      pid);
+		return;
+	}
+
 	cpu = raw_smp_processor_id();
 
 	if (blk_tracer) {
@@ -280,6 +395,19 @@ static DEFINE_MUTEX(blk_tree_mutex);
 
 static void blk_trace_free(struct blk_trace *bt)
 {
+	int cpu;
+
+	if (bt->compact) {
+		for_each_possible_cpu(cpu) {
+			debugfs_remove(bt->compact[cpu].file);
+			vfree(bt->compact[cpu].ring);
+		}
+		kfree(bt->compact);
+	}
+#ifdef CONFIG_BLK_CGROUP
+	if (bt->css)
+		css_put(bt->css);
+#endif
 	debugfs_remove(bt->msg_file);
 	debugfs_remove(bt->dropped_file);
 	relay_close(bt->rchan);
@@ -315,9 +443,15 @@ static ssize_t blk_dropped_read(struct file *filp, char __user *buffer,
 				size_t count, loff_t *ppos)
 {
 	struct blk_trace *bt = filp->private_data;
-	char buf[16];
+	u64 dropped = atomic_read(&bt->dropped);
+	char buf[24];
+	int cpu;
 
-	snprintf(buf, sizeof(buf), "%u\n", atomic_read(&bt->dropped));
+	if (bt->compact)
+		for_each_possible_cpu(cpu)
+			dropped += ACCESS_ONCE(bt->compact[cpu].dropped);
+
+	snprintf(buf, sizeof(buf), "%llu\n", (unsigned long long) dropped);
 
 	return simple_read_from_buffer(buffer, count, ppos, buf, strlen(buf));
 }
@@ -402,6 +536,80 @@ static struct rchan_callbacks blk_relay_callbacks = {
 	.remove_buf_file	= blk_remove_buf_file_callback,
 };
 
+static int blk_compact_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	return remap_vmalloc_range(vma, filp->private_data, vma->vm_pgoff);
+}
+
+static const struct file_operations blk_compact_fops = {
+	.owner =	THIS_MODULE,
+	.open =		simple_open,
+	.mmap =		blk_compact_mmap,
+	.llseek =	noop_llseek,
+};
+
+static int blk_trace_compact_init(struct blk_trace *bt,
+				  struct blk_user_compact_trace_setup *cbuts)
+{
+	unsigned long size;
+	char name[16];
+	int cpu;
+
+	if (!cbuts->nr_records)
+		cbuts->nr_records = BLK_TRACE_COMPACT_DEF_NR;
+	if (!is_power_of_2(cbuts->nr_records) ||
+	    cbuts->nr_records > BLK_TRACE_COMPACT_MAX_NR)
+		return -EINVAL;
+
+#ifdef CONFIG_BLK_CGROUP
+	if (cbuts->cgroup_fd >= 0) {
+		struct cgroup_subsys_state *css;
+		struct fd f = fdget(cbuts->cgroup_fd);
+
+		if (!f.file)
+			return -EBADF;
+
+		css = cgroup_css_from_dir(f.file, blkio_subsys_id);
+		if (!IS_ERR(css))
+			css_get(css);
+		fdput(f);
+		if (IS_ERR(css))
+			return PTR_ERR(css);
+		bt->css = css;
+	}
+#else
+	if (cbuts->cgroup_fd >= 0)
+		return -EINVAL;
+#endif
+
+	bt->compact = kcalloc(nr_cpu_ids, sizeof(*bt->compact), GFP_KERNEL);
+	if (!bt->compact)
+		return -ENOMEM;
+
+	bt->compact_nr = cbuts->nr_records;
+	bt->sample = cbuts->sample;
+
+	size = PAGE_SIZE + bt->compact_nr * sizeof(struct blk_io_trace_compact);
+	for_each_possible_cpu(cpu) {
+		struct blk_trace_compact_buf *buf = &bt->compact[cpu];
+
+		buf->ring = vmalloc_user(size);
+		if (!buf->ring)
+			return -ENOMEM;
+
+		buf->ring->version = BLK_IO_TRACE_COMPACT_VERSION;
+		buf->ring->nr_records = bt->compact_nr;
+
+		snprintf(name, sizeof(name), "compact%d", cpu);
+		buf->file = debugfs_create_file(name, 0600, bt->dir, buf->ring,
+						&blk_compact_fops);
+		if (!buf->file)
+			return -EIO;
+	}
+
+	return 0;
+}
+
 static void blk_trace_setup_lba(struct blk_trace *bt,
 				struct block_device *bdev)
 {
@@ -420,17 +628,19 @@ static void blk_trace_setup_lba(struct blk_trace *bt,
 }
 
 /*
- * Setup everything required to start tracing
+ * Setup everything required to start tracing. With @cbuts, trace into
+ * the compact per-cpu rings instead of relay.
  */
-int do_blk_trace_setup(struct request_queue *q, char *name, dev_t dev,
-		       struct block_device *bdev,
-		       struct blk_user_trace_setup *buts)
+static int __blk_trace_setup(struct request_queue *q, char *name, dev_t dev,
+			     struct block_device *bdev,
+			     struct blk_user_trace_setup *buts,
+			     struct blk_user_compact_trace_setup *cbuts)
 {
 	struct blk_trace *old_bt, *bt = NULL;
 	struct dentry *dir = NULL;
 	int ret, i;
 
-	if (!buts->buf_size || !buts->buf_nr)
+	if (!cbuts && (!buts->buf_size || !buts->buf_nr))
 		return -EINVAL;
 
 	strncpy(buts->name, name, BLKTRACE_BDEV_SIZE);
@@ -488,10 +698,16 @@ int do_blk_trace_setup(struct request_queue *q, char *name, dev_t dev,
 	if (!bt->msg_file)
 		goto err;
 
-	bt->rchan = relay_open("trace", dir, buts->buf_size,
-				buts->buf_nr, &blk_relay_callbacks, bt);
-	if (!bt->rchan)
-		goto err;
+	if (cbuts) {
+		ret = blk_trace_compact_init(bt, cbuts);
+		if (ret)
+			goto err;
+	} else {
+		bt->rchan = relay_open("trace", dir, buts->buf_size,
+					buts->buf_nr, &blk_relay_callbacks, bt);
+		if (!bt->rchan)
+			goto err;
+	}
 
 	bt->act_mask = buts->act_mask;
 	if (!bt->act_mask)
@@ -524,6 +740,13 @@ err:
 	return ret;
 }
 
+int do_blk_trace_setup(struct request_queue *q, char *name, dev_t dev,
+		       struct block_device *bdev,
+		       struct blk_user_trace_setup *buts)
+{
+	return __blk_trace_setup(q, name, dev, bdev, buts, NULL);
+}
+
 int blk_trace_setup(struct request_queue *q, char *name, dev_t dev,
 		    struct block_device *bdev,
 		    char __user *arg)
@@ -547,6 +770,36 @@ int blk_trace_setup(struct request_queue *q, char *name, dev_t dev,
 }
 EXPORT_SYMBOL_GPL(blk_trace_setup);
 
+static int blk_trace_setup_compact(struct request_queue *q, char *name,
+				   dev_t dev, struct block_device *bdev,
+				   char __user *arg)
+{
+	struct blk_user_compact_trace_setup cbuts;
+	struct blk_user_trace_setup buts;
+	int ret;
+
+	if (copy_from_user(&cbuts, arg, sizeof(cbuts)))
+		return -EFAULT;
+
+	buts = (struct blk_user_trace_setup) {
+		.act_mask = cbuts.act_mask,
+		.start_lba = cbuts.start_lba,
+		.end_lba = cbuts.end_lba,
+		.pid = cbuts.pid,
+	};
+
+	ret = __blk_trace_setup(q, name, dev, bdev, &buts, &cbuts);
+	if (ret)
+		return ret;
+
+	memcpy(&cbuts.name, &buts.name, BLKTRACE_BDEV_SIZE);
+	if (copy_to_user(arg, &cbuts, sizeof(cbuts))) {
+		blk_trace_remove(q);
+		return -EFAULT;
+	}
+	return 0;
+}
+
 #if defined(CONFIG_COMPAT) && defined(CONFIG_X86_64)
 static int compat_blk_trace_setup(struct request_queue *q, char *name,
 				  dev_t dev, struct block_device *bdev,
@@ -647,6 +900,10 @@ int blk_trace_ioctl(struct block_device *bdev, unsigned cmd, char __user *arg)
 		ret = compat_blk_trace_setup(q, b, bdev->bd_dev, bdev, arg);
 		break;
 #endif
+	case BLKTRACESETUPCOMPACT:
+		bdevname(bdev, b);
+		ret = blk_trace_setup_compact(q, b, bdev->bd_dev, bdev, arg);
+		break;
 	case BLKTRACESTART:
 		start = 1;
 	case BLKTRACESTOP:
@@ -700,6 +957,9 @@ static void blk_add_trace_rq(struct request_queue *q, struct request *rq,
 	if (likely(!bt))
 		return;
 
+	if (blk_trace_bio_skip(bt, rq->bio))
+		return;
+
 	if (rq->cmd_type == REQ_TYPE_BLOCK_PC) {
 		what |= BLK_TC_ACT(BLK_TC_PC);
 		__blk_add_trace(bt, 0, nr_bytes, rq->cmd_flags,
@@ -763,6 +1023,9 @@ static void blk_add_trace_bio(struct request_queue *q, struct bio *bio,
 	if (likely(!bt))
 		return;
 
+	if (blk_trace_bio_skip(bt, bio))
+		return;
+
 	if (!error && !bio_flagged(bio, BIO_UPTODATE))
 		error = EIO;
 
@@ -2102,7 +2102,9 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 
 		VM_BUG_ON(PageCompound(page));
 		BUG_ON(!PageAnon(page));
-		VM_BUG_ON(!PageSwapBacked(page));
+		/* leave pages marked with MADV_FREE to reclaim */
+		if (!PageSwapBacked(page))
+			goto out;
 
 		/* cannot use mapcount: can't collapse if there's a gup pin */
 		if (page_count(page) != 1)
@@ -59,6 +59,7 @@
 #include <linux/gfp.h>
 #include <linux/migrate.h>
 #include <linux/string.h>
+#include <linux/debugfs.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -3306,6 +3307,122 @@ oom:
 	return VM_FAULT_OOM;
 }
 
+/**
+ * do_set_pte - map a page cache page read-only at @address
+ * @vma:	virtual memory area
+ * @address:	user virtual address
+ * @page:	page to map, the reference is handed to the pte
+ * @pte:	pointer to the target page table entry, which must be none
+ *
+ * Caller holds the page table lock and the page lock.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+#define FAULT_AROUND_PAGES	16
+
+static unsigned long fault_around_pages __read_mostly = FAULT_AROUND_PAGES;
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_pages_get(void *data, u64 *val)
+{
+	*val = fault_around_pages;
+	return 0;
+}
+
+/*
+ * Must be a power of two no larger than a page table, so that the window
+ * never crosses a pmd. 1 disables fault-around.
+ */
+static int fault_around_pages_set(void *data, u64 val)
+{
+	if (!val || val > PTRS_PER_PTE || !is_power_of_2(val))
+		return -EINVAL;
+	fault_around_pages = val;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_pages_fops,
+		fault_around_pages_get, fault_around_pages_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	void *ret;
+
+	ret = debugfs_create_file("fault_around_pages", 0644, NULL, NULL,
+			&fault_around_pages_fops);
+	if (!ret)
+		pr_warn("Failed to create fault_around_pages in debugfs");
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+/*
+ * do_fault_around() tries to map a window of ptes around the faulting
+ * address with pages that are already in the page cache, so that the
+ * neighbouring accesses do not fault at all.
+ *
+ * The window is fault_around_pages wide and aligned to its size, clamped
+ * to the vma and the page table of the faulting address. It starts at
+ * the first pte that is still none; ->map_pages() only fills none ptes.
+ *
+ * Called with the page table lock held.
+ */
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr, nr_pages, mask;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	nr_pages = ACCESS_ONCE(fault_around_pages);
+	mask = ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK;
+
+	start_addr = max(address & mask, vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 * max_pgoff is either end of page table or end of vma
+	 * or fault_around_pages from pgoff, depending what is nearest.
+	 */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min3(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1,
+			pgoff + nr_pages - 1);
+
+	/* Check if it makes any sense to call ->map_pages */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *) start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
 /*
  * __do_fault() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -3334,6 +3451,23 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	int ret;
 	int page_mkwrite = 0;
 
+	/*
+	 * On a read fault, first let the backing store map whatever is
+	 * already cached around the address. If that covered the faulting
+	 * pte, we are done without calling ->fault.
+	 */
+	if (!(flags & (FAULT_FLAG_WRITE | FAULT_FLAG_NONLINEAR)) &&
+	    vma->vm_ops->map_pages && fault_around_pages > 1) {
+		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			count_vm_event(FAULT_AROUND_HIT);
+			return 0;
+		}
+		pte_unmap_unlock(page_table, ptl);
+	}
+
 	/*
 	 * If we do COW later, allocate page befor taking lock_page()
 	 * on the file cache page. This will reduce lock holding time.
@@ -1246,6 +1246,22 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	} else if (PageAnon(page)) {
 		swp_entry_t entry = { .val = page_private(page) };
 
+		/*
+		 * A page marked with MADV_FREE is not swap backed.  If it
+		 * is still clean it can simply be dropped; if it was
+		 * redirtied in the meantime its contents are wanted again.
+		 */
+		if (!PageSwapBacked(page) && TTU_ACTION(flags) == TTU_UNMAP) {
+			if (!PageDirty(page)) {
+				dec_mm_counter(mm, MM_ANONPAGES);
+				goto discard;
+			}
+			set_pte_at(mm, address, pte, pteval);
+			SetPageSwapBacked(page);
+			ret = SWAP_FAIL;
+			goto out_unmap;
+		}
+
 		if (PageSwapCache(page)) {
 			/*
 			 * Store the swap location in the pte.
@@ -1284,6 +1300,7 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	} else
 		dec_mm_counter(mm, MM_FILEPAGES);
 
+discard:
 	page_remove_rmap(page);
 	page_cache_release(page);
 
@@ -42,6 +42,7 @@ int page_cluster;
 static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
 static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);//pageӵinactive lruβrotate_reclaimable_page()
 static DEFINE_PER_CPU(struct pagevec, lru_deactivate_pvecs);//deactivate_page(),pageӵinactive lruͷ
+static DEFINE_PER_CPU(struct pagevec, lru_lazyfree_pvecs);
 
 /*
  * This path almost never happens for VM activity - pages are normally
@@ -675,6 +676,30 @@ static void lru_deactivate_fn(struct page *page, struct lruvec *lruvec,
 	update_page_reclaim_stat(lruvec, file, 0);
 }
 
+/*
+ * Move a clean anonymous page marked with MADV_FREE to the inactive
+ * file list.  Clearing PG_swapbacked tells reclaim that the page can
+ * be dropped without swapping it out, unless it is redirtied first.
+ */
+static void lru_lazyfree_fn(struct page *page, struct lruvec *lruvec,
+			    void *arg)
+{
+	if (PageLRU(page) && PageAnon(page) && PageSwapBacked(page) &&
+	    !PageSwapCache(page) && !PageUnevictable(page)) {
+		bool active = PageActive(page);
+
+		del_page_from_lru_list(page, lruvec,
+				       LRU_INACTIVE_ANON + active);
+		ClearPageActive(page);
+		ClearPageReferenced(page);
+		ClearPageSwapBacked(page);
+		add_page_to_lru_list(page, lruvec, LRU_INACTIVE_FILE);
+
+		__count_vm_event(PGLAZYFREE);
+		update_page_reclaim_stat(lruvec, 1, 0);
+	}
+}
+
 /*
  * Drain pages out of the cpu's pagevecs.
  * Either "cpu" is the current CPU, and preemption has already been
@@ -711,6 +736,10 @@ void lru_add_drain_cpu(int cpu)
 	if (pagevec_count(pvec))//pagevecpage
 		pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);//pageӵinactive lruͷ
 
+	pvec = &per_cpu(lru_lazyfree_pvecs, cpu);
+	if (pagevec_count(pvec))
+		pagevec_lru_move_fn(pvec, lru_lazyfree_fn, NULL);
+
 	activate_page_drain(cpu);
 }
 
@@ -742,6 +771,26 @@ void deactivate_page(struct page *page)
 		put_cpu_var(lru_deactivate_pvecs);
 	}
 }
+
+/**
+ * mark_page_lazyfree - make an anon page lazyfree
+ * @page: page to mark lazyfree
+ *
+ * mark_page_lazyfree() moves @page to the inactive file list.
+ * This is done to accelerate the reclaim of @page.
+ */
+void mark_page_lazyfree(struct page *page)
+{
+	if (PageLRU(page) && PageAnon(page) && PageSwapBacked(page) &&
+	    !PageSwapCache(page) && !PageUnevictable(page)) {
+		struct pagevec *pvec = &get_cpu_var(lru_lazyfree_pvecs);
+
+		page_cache_get(page);
+		if (!pagevec_add(pvec, page))
+			pagevec_lru_move_fn(pvec, lru_lazyfree_fn, NULL);
+		put_cpu_var(lru_lazyfree_pvecs);
+	}
+}
 //cpulruϵpageƶ active/inactive lru
 void lru_add_drain(void)
 {
@@ -759,6 +759,8 @@ const char * const vmstat_text[] = {
 
 	"pgfault",
 	"pgmajfault",
+	"fault_around_hit",
+	"fault_around_mapped",
 
 	TEXTS_FOR_ZONES("pgrefill")
 	TEXTS_FOR_ZONES("pgsteal_kswapd")
@@ -779,6 +781,8 @@ const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pglazyfree",
+	"pglazyfreed",
 
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",